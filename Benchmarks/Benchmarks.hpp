@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <latch>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "../Utilities/Instrumentation.hpp"
+
+/*
+ * Scalability benchmark harness
+ *  Every worker runs a pre generated list of operations so random number generation stays out of the timing,
+ *  each operation is timed individually into a sharded histogram and the run reports ops/sec and latency percentiles.
+ *  Scaling efficiency is throughput(n) / (n * throughput(1)) within a group of otherwise identical runs.
+ */
+
+namespace Benchmarks{
+
+    enum class distribution { uniform, zipfian };
+
+    inline std::string to_string(distribution d){
+        return d == distribution::uniform ? "uniform" : "zipfian";
+    }
+
+    inline distribution distribution_from_string(const std::string& s){
+        if(s == "uniform"){
+            return distribution::uniform;
+        }
+        if(s == "zipfian" || s == "zipf"){
+            return distribution::zipfian;
+        }
+        throw std::invalid_argument("Unknown key distribution: " + s);
+    }
+
+    // Zipfian key generator over [0, n), rank 0 the hottest; inverse CDF by binary search
+    class zipfian_generator{
+        std::vector<double> cdf;
+    public:
+        explicit zipfian_generator(std::size_t n, double skew = 0.99): cdf(n){
+            double sum = 0;
+            for(std::size_t i = 0; i < n; ++i){
+                sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+                cdf[i] = sum;
+            }
+            for(auto& c: cdf){
+                c /= sum;
+            }
+        }
+        template<typename Generator>
+        std::size_t operator()(Generator& gen) const{
+            const double u = std::uniform_real_distribution<>(0.0, 1.0)(gen);
+            return std::min<std::size_t>(static_cast<std::size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()), cdf.size() - 1);
+        }
+    };
+
+    struct operation{
+        bool write;
+        std::uint32_t key;
+    };
+
+    // One operation list per thread, seeded by thread index so runs are repeatable
+    inline std::vector<std::vector<operation>> generate_operations(unsigned threads, std::size_t ops_per_thread, double read_ratio,
+                                                                   distribution dist, std::size_t key_space){
+        const zipfian_generator zipf(dist == distribution::zipfian ? key_space : 1);
+        std::vector<std::vector<operation>> all(threads);
+        for(unsigned t = 0; t < threads; ++t){
+            std::mt19937_64 gen(t + 1);
+            std::uniform_int_distribution<std::size_t> uniform_key(0, key_space - 1);
+            std::bernoulli_distribution is_read(read_ratio);
+            all[t].reserve(ops_per_thread);
+            for(std::size_t i = 0; i < ops_per_thread; ++i){
+                const std::size_t key = dist == distribution::uniform ? uniform_key(gen) : zipf(gen);
+                all[t].push_back({!is_read(gen), static_cast<std::uint32_t>(key)});
+            }
+        }
+        return all;
+    }
+
+    // Element type of a given size for the container benchmarks
+    template<std::size_t N>
+    struct payload{
+        std::byte bytes[N]{};
+    };
+
+    inline constexpr std::size_t payload_sizes[] = {8, 64, 512, 4096};
+
+    // Calls f.template operator()<payload<N>>() for the compiled payload size matching size
+    template<typename F>
+    void with_payload(std::size_t size, F&& f){
+        switch(size){
+            case 8: f.template operator()<payload<8>>(); break;
+            case 64: f.template operator()<payload<64>>(); break;
+            case 512: f.template operator()<payload<512>>(); break;
+            case 4096: f.template operator()<payload<4096>>(); break;
+            default: throw std::invalid_argument("Unsupported payload size: " + std::to_string(size));
+        }
+    }
+
+    struct result{
+        std::string benchmark;
+        unsigned threads{1};
+        double read_ratio{0};
+        std::string distribution;
+        std::size_t payload{0};
+        std::uint64_t ops{0};
+        double seconds{0};
+        double ops_per_sec{0};
+        std::uint64_t p50_ns{0};
+        std::uint64_t p99_ns{0};
+        std::uint64_t p999_ns{0};
+        double scaling_efficiency{1};
+        double bytes_per_sec{0}; // only for memory bound benchmarks
+    };
+
+    // Starts threads together, op(thread, index) is timed per call
+    template<typename Op>
+    result run(unsigned threads, std::size_t ops_per_thread, Op&& op){
+        using clock = std::chrono::steady_clock;
+        auto latency = std::make_unique<Instrumentation::histogram>();
+        std::latch start(threads);
+        // Each worker stamps its own window, the run spans the first start to the last end
+        std::vector<clock::time_point> began(threads), ended(threads);
+        std::vector<std::jthread> workers;
+        workers.reserve(threads);
+        for(unsigned t = 0; t < threads; ++t){
+            workers.emplace_back([&, t]{
+                start.arrive_and_wait();
+                began[t] = clock::now();
+                for(std::size_t i = 0; i < ops_per_thread; ++i){
+                    const auto before = clock::now();
+                    op(t, i);
+                    latency->record(Instrumentation::elapsed_ns(before, clock::now()));
+                }
+                ended[t] = clock::now();
+            });
+        }
+        for(auto& w: workers){
+            w.join();
+        }
+
+        const auto snapshot = latency->merge();
+        result r;
+        r.threads = threads;
+        r.ops = snapshot.total;
+        r.seconds = threads ? std::chrono::duration<double>(*std::max_element(ended.begin(), ended.end()) -
+                                                         *std::min_element(began.begin(), began.end())).count() : 0;
+        r.ops_per_sec = r.seconds > 0 ? static_cast<double>(r.ops) / r.seconds : 0;
+        r.p50_ns = snapshot.percentile(0.50);
+        r.p99_ns = snapshot.percentile(0.99);
+        r.p999_ns = snapshot.percentile(0.999);
+        return r;
+    }
+
+    // Fills in scaling_efficiency against the single thread run of the same configuration, when there is one
+    inline void compute_scaling(std::vector<result>& results){
+        using key = std::tuple<std::string, double, std::string, std::size_t>;
+        std::map<key, double> single;
+        for(const auto& r: results){
+            if(r.threads == 1){
+                single[key{r.benchmark, r.read_ratio, r.distribution, r.payload}] = r.ops_per_sec;
+            }
+        }
+        for(auto& r: results){
+            const auto it = single.find(key{r.benchmark, r.read_ratio, r.distribution, r.payload});
+            r.scaling_efficiency = (it != single.end() && it->second > 0) ? r.ops_per_sec / (it->second * r.threads) : 0;
+        }
+    }
+
+    inline void write_json(std::ostream& os, const std::vector<result>& results){
+        os << "{\"hardware_concurrency\":" << std::thread::hardware_concurrency() << ",\"results\":[";
+        bool first = true;
+        for(const auto& r: results){
+            os << (first ? "\n" : ",\n")
+               << "{\"benchmark\":\"" << r.benchmark << "\""
+               << ",\"threads\":" << r.threads
+               << ",\"read_ratio\":" << r.read_ratio
+               << ",\"distribution\":\"" << r.distribution << "\""
+               << ",\"payload\":" << r.payload
+               << ",\"ops\":" << r.ops
+               << ",\"seconds\":" << r.seconds
+               << ",\"ops_per_sec\":" << r.ops_per_sec
+               << ",\"p50_ns\":" << r.p50_ns
+               << ",\"p99_ns\":" << r.p99_ns
+               << ",\"p999_ns\":" << r.p999_ns
+               << ",\"scaling_efficiency\":" << r.scaling_efficiency;
+            if(r.bytes_per_sec > 0){
+                os << ",\"bytes_per_sec\":" << r.bytes_per_sec;
+            }
+            os << "}";
+            first = false;
+        }
+        os << "\n]}\n";
+    }
+
+    // Parses "a,b,c" into values
+    template<typename T, typename Parse>
+    std::vector<T> parse_list(const std::string& text, Parse parse){
+        std::vector<T> out;
+        std::stringstream ss(text);
+        std::string item;
+        while(std::getline(ss, item, ',')){
+            if(!item.empty()){
+                out.push_back(parse(item));
+            }
+        }
+        return out;
+    }
+
+    // 1, 2, 4, ... up to and including hardware_concurrency
+    inline std::vector<unsigned> default_thread_counts(){
+        const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned> counts;
+        for(unsigned n = 1; n < hw; n *= 2){
+            counts.push_back(n);
+        }
+        counts.push_back(hw);
+        return counts;
+    }
+
+} // Benchmarks
@@ -0,0 +1,445 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <limits>
+
+#include "Benchmarks.hpp"
+#include "../Hello/basics.hpp"
+#include "../DataSharing/DataSharing.hpp"
+#include "../Synchronization/Synchronization.hpp"
+#include "../Synchronization/TimerWheel.hpp"
+
+/*
+ * Usage: Benchmarks [--threads 1,2,4] [--reads 0.5,0.9] [--dist uniform,zipfian] [--payload 8,64,512,4096]
+ *                   [--ops N] [--keys N] [--elements N] [--only stack,queue,dns_cache,int_list,parallel_accumulate,numa_bandwidth,priority_tail,timer_wheel]
+ * Results are written to stdout as JSON.
+ */
+
+struct config{
+    std::vector<unsigned> threads = Benchmarks::default_thread_counts();
+    std::vector<double> read_ratios{0.5, 0.9};
+    std::vector<Benchmarks::distribution> distributions{Benchmarks::distribution::uniform, Benchmarks::distribution::zipfian};
+    std::vector<std::size_t> payloads{8, 512};
+    std::size_t ops_per_thread = 20000;
+    std::size_t key_space = 1024;
+    std::size_t accumulate_elements = 1 << 20;
+    std::vector<std::string> only;
+
+    [[nodiscard]] bool selected(const std::string& name) const{
+        return only.empty() || std::find(only.begin(), only.end(), name) != only.end();
+    }
+};
+
+config parse_arguments(int argc, char** argv){
+    config c;
+    for(int i = 1; i < argc; i += 2){
+        const std::string flag = argv[i];
+        if(i + 1 == argc){
+            throw std::invalid_argument("Missing value for " + flag);
+        }
+        const std::string value = argv[i + 1];
+        if(flag == "--threads"){
+            c.threads = Benchmarks::parse_list<unsigned>(value, [](const std::string& s){return static_cast<unsigned>(std::stoul(s));});
+        } else if(flag == "--reads"){
+            c.read_ratios = Benchmarks::parse_list<double>(value, [](const std::string& s){return std::stod(s);});
+        } else if(flag == "--dist"){
+            c.distributions = Benchmarks::parse_list<Benchmarks::distribution>(value, Benchmarks::distribution_from_string);
+        } else if(flag == "--payload"){
+            c.payloads = Benchmarks::parse_list<std::size_t>(value, [](const std::string& s){return std::stoul(s);});
+        } else if(flag == "--ops"){
+            c.ops_per_thread = std::stoul(value);
+        } else if(flag == "--keys"){
+            c.key_space = std::stoul(value);
+        } else if(flag == "--elements"){
+            c.accumulate_elements = std::stoul(value);
+        } else if(flag == "--only"){
+            c.only = Benchmarks::parse_list<std::string>(value, [](const std::string& s){return s;});
+        } else {
+            throw std::invalid_argument("Unknown option: " + flag);
+        }
+    }
+    if(c.threads.empty() || std::find(c.threads.begin(), c.threads.end(), 0u) != c.threads.end()){
+        throw std::invalid_argument("--threads needs counts of at least 1");
+    }
+    if(std::any_of(c.read_ratios.begin(), c.read_ratios.end(), [](double r){return !(r >= 0.0 && r <= 1.0);})){
+        throw std::invalid_argument("--reads needs ratios in [0, 1]");
+    }
+    for(std::size_t size: c.payloads){
+        if(std::find(std::begin(Benchmarks::payload_sizes), std::end(Benchmarks::payload_sizes), size) == std::end(Benchmarks::payload_sizes)){
+            throw std::invalid_argument("Unsupported payload size: " + std::to_string(size));
+        }
+    }
+    if(c.key_space == 0 || c.key_space > std::numeric_limits<std::uint32_t>::max()){
+        throw std::invalid_argument("--keys needs between 1 and 2^32 - 1 keys");
+    }
+    return c;
+}
+
+// push for writes, pop for reads; the stack starts with one thread's worth of elements so reads rarely hit empty
+void bench_stack(const config& c, std::vector<Benchmarks::result>& results){
+    for(std::size_t size: c.payloads){
+        Benchmarks::with_payload(size, [&]<typename P>(){
+            for(double reads: c.read_ratios){
+                for(unsigned n: c.threads){
+                    AdaptedStack::threadsafe_stack<P> stack;
+                    for(std::size_t i = 0; i < c.ops_per_thread; ++i){
+                        stack.push(P{});
+                    }
+                    const auto ops = Benchmarks::generate_operations(n, c.ops_per_thread, reads, Benchmarks::distribution::uniform, 1);
+                    auto r = Benchmarks::run(n, c.ops_per_thread, [&](unsigned t, std::size_t i){
+                        if(ops[t][i].write){
+                            stack.push(P{});
+                        } else {
+                            P value;
+                            try{
+                                stack.pop(value);
+                            } catch(const AdaptedStack::empty_stack&){
+                            }
+                        }
+                    });
+                    r.benchmark = "threadsafe_stack";
+                    r.read_ratio = reads;
+                    r.distribution = "none";
+                    r.payload = size;
+                    results.push_back(r);
+                }
+            }
+        });
+    }
+}
+
+// push for writes, try_pop for reads
+void bench_queue(const config& c, std::vector<Benchmarks::result>& results){
+    for(std::size_t size: c.payloads){
+        Benchmarks::with_payload(size, [&]<typename P>(){
+            for(double reads: c.read_ratios){
+                for(unsigned n: c.threads){
+                    ThreadSafe_Queue_ConditionVariables::threadsafe_queue<P> queue;
+                    for(std::size_t i = 0; i < c.ops_per_thread; ++i){
+                        queue.push(P{});
+                    }
+                    const auto ops = Benchmarks::generate_operations(n, c.ops_per_thread, reads, Benchmarks::distribution::uniform, 1);
+                    auto r = Benchmarks::run(n, c.ops_per_thread, [&](unsigned t, std::size_t i){
+                        if(ops[t][i].write){
+                            queue.push(P{});
+                        } else {
+                            P value;
+                            queue.try_pop(value);
+                        }
+                    });
+                    r.benchmark = "threadsafe_queue";
+                    r.read_ratio = reads;
+                    r.distribution = "none";
+                    r.payload = size;
+                    results.push_back(r);
+                }
+            }
+        });
+    }
+}
+
+// find_entry for reads, update_or_add_entry with a payload sized value for writes, on a pre-populated key space
+void bench_dns_cache(const config& c, std::vector<Benchmarks::result>& results){
+    std::vector<std::string> keys(c.key_space);
+    for(std::size_t k = 0; k < c.key_space; ++k){
+        keys[k] = "host" + std::to_string(k) + ".example";
+    }
+    for(std::size_t size: c.payloads){
+        const SharedDataProtection::Dns_entry value(std::string(size, 'x'));
+        for(auto dist: c.distributions){
+            for(double reads: c.read_ratios){
+                for(unsigned n: c.threads){
+                    SharedDataProtection::Dns_cache cache;
+                    for(const auto& k: keys){
+                        cache.update_or_add_entry(k, value);
+                    }
+                    const auto ops = Benchmarks::generate_operations(n, c.ops_per_thread, reads, dist, c.key_space);
+                    auto r = Benchmarks::run(n, c.ops_per_thread, [&](unsigned t, std::size_t i){
+                        const auto& op = ops[t][i];
+                        if(op.write){
+                            cache.update_or_add_entry(keys[op.key], value);
+                        } else {
+                            [[maybe_unused]] auto entry = cache.find_entry(keys[op.key]);
+                        }
+                    });
+                    r.benchmark = "dns_cache";
+                    r.read_ratio = reads;
+                    r.distribution = Benchmarks::to_string(dist);
+                    r.payload = size;
+                    results.push_back(r);
+                }
+            }
+        }
+    }
+}
+
+// list_contains for reads, add_to_list for writes; the list is emptied before each run since reads scan it
+void bench_int_list(const config& c, std::vector<Benchmarks::result>& results){
+    for(auto dist: c.distributions){
+        for(double reads: c.read_ratios){
+            for(unsigned n: c.threads){
+                {
+                    std::lock_guard guard(MutexExample::int_list_mutex);
+                    MutexExample::int_list.clear();
+                }
+                const auto ops = Benchmarks::generate_operations(n, c.ops_per_thread, reads, dist, c.key_space);
+                auto r = Benchmarks::run(n, c.ops_per_thread, [&](unsigned t, std::size_t i){
+                    const auto& op = ops[t][i];
+                    if(op.write){
+                        MutexExample::add_to_list(static_cast<int>(op.key));
+                    } else {
+                        [[maybe_unused]] bool found = MutexExample::list_contains(static_cast<int>(op.key));
+                    }
+                });
+                r.benchmark = "int_list";
+                r.read_ratio = reads;
+                r.distribution = Benchmarks::to_string(dist);
+                r.payload = sizeof(int);
+                results.push_back(r);
+            }
+        }
+    }
+}
+
+// One caller, each operation is a whole parallel_accumulate capped at the thread count
+void bench_parallel_accumulate(const config& c, std::vector<Benchmarks::result>& results){
+    std::vector<int> data(c.accumulate_elements);
+    std::iota(data.begin(), data.end(), 0);
+    const std::size_t calls = std::max<std::size_t>(1, c.ops_per_thread / 1000);
+    for(unsigned n: c.threads){
+        auto r = Benchmarks::run(1, calls, [&](unsigned, std::size_t){
+            [[maybe_unused]] long long sum = threads_at_runtime::parallel_accumulate(data.begin(), data.end(), 0LL, n);
+        });
+        r.benchmark = "parallel_accumulate";
+        r.threads = n;
+        r.read_ratio = 1;
+        r.distribution = "none";
+        r.payload = c.accumulate_elements;
+        results.push_back(r);
+    }
+}
+
+// parallel_accumulate over a node_buffer: blocks first touched and summed by workers spread over the nodes,
+// against the same buffer written by one thread and summed by unpinned workers
+void bench_numa_bandwidth(const config& c, std::vector<Benchmarks::result>& results){
+    const std::size_t calls = std::max<std::size_t>(1, c.ops_per_thread / 1000);
+    const auto bytes = static_cast<double>(c.accumulate_elements * sizeof(int));
+    for(unsigned n: c.threads){
+        // Same worker count parallel_accumulate will settle on, so first touch blocks line up with its blocks
+        const unsigned long workers = std::min<unsigned long>({n, Placement::topology::system().pool_size(Placement::policy::spread, n),
+                                                               (c.accumulate_elements + 24) / 25});
+        for(auto placement: {Placement::policy::spread, Placement::policy::none}){
+            const bool local = placement == Placement::policy::spread;
+            Placement::node_buffer<int> data(c.accumulate_elements);
+            Placement::first_touch(data, local ? workers : 1, placement, [](std::size_t i){return static_cast<int>(i);});
+            auto r = Benchmarks::run(1, calls, [&](unsigned, std::size_t){
+                [[maybe_unused]] long long sum = threads_at_runtime::parallel_accumulate(data.begin(), data.end(), 0LL, n, placement);
+            });
+            r.benchmark = local ? "numa_accumulate_local" : "numa_accumulate_unpinned";
+            r.threads = n;
+            r.read_ratio = 1;
+            r.distribution = "none";
+            r.payload = c.accumulate_elements;
+            r.bytes_per_sec = r.ops_per_sec * bytes;
+            results.push_back(r);
+        }
+    }
+}
+
+struct stamped_chunk{
+    std::chrono::steady_clock::time_point pushed;
+    bool urgent{false};
+};
+
+// Urgent chunk latency behind a saturating bulk backlog: n bulk producers keep about key_space chunks queued
+// while one producer adds an urgent chunk every 50us and one consumer drains. Reports push to pop latency
+// of the urgent chunks only, for the priority queue and for plain FIFO with the same load
+template<typename Queue, typename Push>
+Benchmarks::result urgent_tail(const config& c, unsigned bulk_producers, Queue& queue, Push push){
+    using clock = std::chrono::steady_clock;
+    const std::size_t urgent_count = std::max<std::size_t>(100, c.ops_per_thread / 10);
+    auto latency = std::make_unique<Instrumentation::histogram>();
+    std::atomic<std::size_t> backlog{0};
+    std::uint64_t consumed = 0;
+    const auto began = clock::now();
+    {
+        std::vector<std::jthread> producers;
+        for(unsigned p = 0; p < bulk_producers; ++p){
+            producers.emplace_back([&](std::stop_token stop){
+                while(!stop.stop_requested()){
+                    if(backlog.load(std::memory_order_relaxed) >= c.key_space){
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    backlog.fetch_add(1, std::memory_order_relaxed);
+                    push(stamped_chunk{clock::now(), false});
+                }
+            });
+        }
+        std::jthread urgent([&]{
+            for(std::size_t i = 0; i < urgent_count; ++i){
+                push(stamped_chunk{clock::now(), true});
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        });
+        std::size_t urgent_seen = 0;
+        while(urgent_seen < urgent_count){
+            stamped_chunk chunk;
+            queue.wait_and_pop(chunk);
+            ++consumed;
+            if(chunk.urgent){
+                latency->record(Instrumentation::elapsed_ns(chunk.pushed, clock::now()));
+                ++urgent_seen;
+            } else {
+                backlog.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        for(auto& p: producers){
+            p.request_stop();
+        }
+    }
+    const auto snapshot = latency->merge();
+    Benchmarks::result r;
+    r.threads = bulk_producers;
+    r.read_ratio = 0.5;
+    r.distribution = "none";
+    r.payload = sizeof(stamped_chunk);
+    r.ops = consumed;
+    r.seconds = std::chrono::duration<double>(clock::now() - began).count();
+    r.ops_per_sec = static_cast<double>(consumed) / r.seconds;
+    r.p50_ns = snapshot.percentile(0.50);
+    r.p99_ns = snapshot.percentile(0.99);
+    r.p999_ns = snapshot.percentile(0.999);
+    return r;
+}
+
+void bench_priority_tail(const config& c, std::vector<Benchmarks::result>& results){
+    for(unsigned n: c.threads){
+        {
+            ThreadSafe_Queue_ConditionVariables::threadsafe_priority_queue<stamped_chunk> queue;
+            auto r = urgent_tail(c, n, queue, [&](stamped_chunk chunk){
+                const std::size_t lane = chunk.urgent ? 0 : 3;
+                queue.push(chunk, lane);
+            });
+            r.benchmark = "priority_queue_urgent_tail";
+            results.push_back(r);
+        }
+        {
+            ThreadSafe_Queue_ConditionVariables::threadsafe_queue<stamped_chunk> queue;
+            auto r = urgent_tail(c, n, queue, [&](stamped_chunk chunk){queue.push(chunk);});
+            r.benchmark = "fifo_queue_urgent_tail";
+            results.push_back(r);
+        }
+    }
+}
+
+// ops_per_thread * 50 one shot timers (10^6 by default) are scheduled by n threads, every other one is then
+// cancelled, and the rest report how late they fired. Delays are uniform in 1..1000ms on top of a lead time
+// longer than the schedule and cancel phases take, so every cancel finds its timer still pending
+void bench_timer_wheel(const config& c, std::vector<Benchmarks::result>& results){
+    using clock = std::chrono::steady_clock;
+    const std::size_t timers = c.ops_per_thread * 50;
+    const auto lead = std::chrono::seconds(2);
+    for(unsigned n: c.threads){
+        const std::size_t per_thread = timers / n;
+        auto lateness = std::make_unique<Instrumentation::histogram>();
+        std::vector<std::vector<TimerWheel::timer_handle>> handles(n, std::vector<TimerWheel::timer_handle>(per_thread));
+        std::vector<std::vector<clock::duration>> delays(n);
+        for(unsigned t = 0; t < n; ++t){
+            std::mt19937_64 gen(t + 1);
+            std::uniform_int_distribution<int> ms(1, 1000);
+            for(std::size_t i = 0; i < per_thread; ++i){
+                delays[t].push_back(lead + std::chrono::milliseconds(ms(gen)));
+            }
+        }
+        TimerWheel::timer_wheel wheel;
+        wheel.reserve(timers);
+        std::atomic<std::size_t> fired_count{0};
+        std::atomic<std::size_t> cancel_hits{0};
+        const auto began = clock::now();
+
+        auto scheduled = Benchmarks::run(n, per_thread, [&](unsigned t, std::size_t i){
+            const auto due = clock::now() + delays[t][i];
+            handles[t][i] = wheel.schedule_at(due, [&lateness, &fired_count, due]{
+                lateness->record(Instrumentation::elapsed_ns(due, clock::now()));
+                fired_count.fetch_add(1, std::memory_order_release);
+            });
+        });
+        scheduled.benchmark = "timer_wheel_schedule";
+        auto cancelled = Benchmarks::run(n, per_thread / 2, [&](unsigned t, std::size_t i){
+            if(wheel.cancel(handles[t][i * 2])){
+                cancel_hits.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        cancelled.benchmark = "timer_wheel_cancel";
+        const std::size_t missed = cancelled.ops - cancel_hits.load();
+        if(missed != 0){
+            std::cerr << "timer_wheel_cancel: " << missed << " of " << cancelled.ops
+                      << " timers fired before they could be cancelled" << std::endl;
+        }
+
+        // pending() drops to zero before the last callbacks run, so wait for the firings themselves
+        const std::size_t expected = n * per_thread - cancel_hits.load();
+        while(fired_count.load(std::memory_order_acquire) < expected){
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        const auto snapshot = lateness->merge();
+        Benchmarks::result fired;
+        fired.benchmark = "timer_wheel_fire_lateness";
+        fired.threads = n;
+        fired.ops = snapshot.total;
+        fired.seconds = std::chrono::duration<double>(clock::now() - began).count();
+        fired.ops_per_sec = static_cast<double>(fired.ops) / fired.seconds;
+        fired.p50_ns = snapshot.percentile(0.50);
+        fired.p99_ns = snapshot.percentile(0.99);
+        fired.p999_ns = snapshot.percentile(0.999);
+        for(auto* r: {&scheduled, &cancelled, &fired}){
+            r->distribution = "uniform";
+            r->payload = timers;
+            results.push_back(*r);
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    // parallel_accumulate and friends log at info, keep them out of the measurements and the JSON
+    Logging::set_level(Logging::level::warn);
+
+    config c;
+    try{
+        c = parse_arguments(argc, argv);
+    } catch(const std::exception& e){
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<Benchmarks::result> results;
+    if(c.selected("stack")){
+        bench_stack(c, results);
+    }
+    if(c.selected("queue")){
+        bench_queue(c, results);
+    }
+    if(c.selected("dns_cache")){
+        bench_dns_cache(c, results);
+    }
+    if(c.selected("int_list")){
+        bench_int_list(c, results);
+    }
+    if(c.selected("parallel_accumulate")){
+        bench_parallel_accumulate(c, results);
+    }
+    if(c.selected("numa_bandwidth")){
+        bench_numa_bandwidth(c, results);
+    }
+    if(c.selected("priority_tail")){
+        bench_priority_tail(c, results);
+    }
+    if(c.selected("timer_wheel")){
+        bench_timer_wheel(c, results);
+    }
+
+    Benchmarks::compute_scaling(results);
+    Benchmarks::write_json(std::cout, results);
+}
@@ -13,12 +13,15 @@
 #include <shared_mutex>
 #include <utility>
 
+#include "../Utilities/Logging.hpp"
+#include "../Utilities/Instrumentation.hpp"
+
 namespace DataSharing{
 
     class background_task{
     public:
         void operator()() const{
-            std::cout << "Hello from function object" << std::endl;
+            Logging::info("Hello from function object");
         }
 
     };
@@ -34,7 +37,7 @@ namespace MutexExample{
      *  Passing them as arguments to user supplied functions
      */
     std::list<int> int_list;
-    std::mutex int_list_mutex;
+    Instrumentation::mutex<std::mutex, "MutexExample::int_list_mutex"> int_list_mutex;
 
     void add_to_list(int new_value){
         std::lock_guard guard(int_list_mutex); // cpp17, class template argument deduction
@@ -54,7 +57,7 @@ namespace MutexExample{
 
     void check_for_some_ints(){
         for(int i = 3; i < 15; i+=2){
-            std::cout << i << " " << list_contains(i) << std::endl;
+            Logging::info(i, " ", list_contains(i));
         }
     }
 
@@ -64,27 +67,28 @@ namespace MutexExample{
 namespace AdaptedStack{
 
     struct empty_stack: std::exception {
-        [[nodiscard]] const char* what() const override {return "Stack Empty";}
+        [[nodiscard]] const char* what() const noexcept override {return "Stack Empty";}
     };
 
     template<typename T>
     class threadsafe_stack{
     private:
+        using mutex_type = Instrumentation::mutex<std::mutex, "threadsafe_stack::m">;
         std::stack<T> data;
-        mutable std::mutex m;
+        mutable mutex_type m;
     public:
         threadsafe_stack() = default;
         threadsafe_stack(const threadsafe_stack& other){
-            std::lock_guard<std::mutex> lock(other.m);
+            std::lock_guard<mutex_type> lock(other.m);
             data = other.data;
         }
         threadsafe_stack& operator=(const threadsafe_stack&) = delete;
         void push(T new_value){
-            std::lock_guard<std::mutex> lock(m);
+            std::lock_guard<mutex_type> lock(m);
             data.push(std::move(new_value));
         }
         std::shared_ptr<T> pop(){
-            std::lock_guard<std::mutex> lock(m);
+            std::lock_guard<mutex_type> lock(m);
             if(data.empty()){
                 throw empty_stack();
             }
@@ -93,7 +97,7 @@ namespace AdaptedStack{
             return res;
         }
         void pop(T& value){
-            std::lock_guard<std::mutex> lock(m);
+            std::lock_guard<mutex_type> lock(m);
             if(data.empty()){
                 throw empty_stack();
             }
@@ -101,7 +105,7 @@ namespace AdaptedStack{
             data.pop();
         }
         bool empty() const{
-            std::lock_guard<std::mutex> lock(m);
+            std::lock_guard<mutex_type> lock(m);
             return data.empty();
         }
 
@@ -166,7 +170,7 @@ namespace SharedDataProtection{
     class Resource{
     public:
         Resource() = default;
-        static void say_something(){std::cout << "Resource say something" << std::endl;}
+        static void say_something(){Logging::info("Resource say something");}
     };
 
     std::shared_ptr<Resource> resource_ptr;
@@ -218,16 +222,17 @@ namespace SharedDataProtection{
         std::string to_string() const {return entry;}
     };
     class Dns_cache{
+        using mutex_type = Instrumentation::mutex<std::shared_mutex, "Dns_cache::entry_mutex">;
         std::map<std::string, Dns_entry> entries;
-        mutable std::shared_mutex entry_mutex;
+        mutable mutex_type entry_mutex;
     public:
         Dns_entry find_entry(const std::string& domain) const{
-            std::shared_lock<std::shared_mutex> lk(entry_mutex);
+            std::shared_lock<mutex_type> lk(entry_mutex);
             const std::map<std::string, Dns_entry>::const_iterator it = entries.find(domain); // or const auto
             return (it == entries.end()) ? Dns_entry() : it->second();
         }
         void update_or_add_entry(const std::string& domain, const Dns_entry& dns_details){
-            std::lock_guard<std::shared_mutex> lk(entry_mutex);
+            std::lock_guard<mutex_type> lk(entry_mutex);
             entries[domain] = dns_details;
         }
     };
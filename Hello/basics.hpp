@@ -1,13 +1,17 @@
 #include <iostream>
 #include <thread>
 #include <numeric>
+#include <vector>
+
+#include "../Utilities/Logging.hpp"
+#include "../Utilities/Placement.hpp"
 
 namespace basics{
 
     class background_task{
     public:
         void operator()() const{
-            std::cout << "Hello from function object" << std::endl;
+            Logging::info("Hello from function object");
         }
 
     };
@@ -20,8 +24,8 @@ namespace memory_management{
         explicit func(int& _i): i(_i){}
         void operator()(){
             for(unsigned j = 0; j < 10; ++j){
-                std::cout << j << std::endl;
-                std::cout << i << std::endl; // Access to a variable that might be deleted
+                Logging::info(j);
+                Logging::info(i); // Access to a variable that might be deleted
             }
         }
     };
@@ -56,17 +60,17 @@ namespace memory_management{
         func my_func(local);
         std::thread t(my_func);
         thread_guard g(t);
-        std::cout << "Work in current thread" << std::endl;
+        Logging::info("Work in current thread");
     }
 }
 
 namespace thread_ownership{
     void some_function(){
-        std::cout << "Some function" << std::endl;
+        Logging::info("Some function");
     }
 
     void some_other_function(int i){
-        std::cout << "Other function " << i << std::endl;
+        Logging::info("Other function ", i);
     }
 
     std::thread return_thread(){
@@ -161,10 +165,10 @@ namespace thread_ownership{
         }
     };
 
-    void vector_of_work_threads(){
+    void vector_of_work_threads(Placement::policy placement = Placement::policy::none){
         std::vector<std::thread> threads;
         for(unsigned i=0; i<20; i++){
-            threads.emplace_back(some_other_function, i);
+            threads.push_back(Placement::make_thread(placement, i, some_other_function, i));
         }
         for(auto& entry: threads){
             entry.join();
@@ -181,33 +185,45 @@ namespace threads_at_runtime{
         }
     };
 
+    // thread_limit caps the number of threads used, 0 leaves it to the hardware
+    // With a placement policy every block, including the last, runs on a placed worker and the calling thread
+    // only waits; block i goes to worker i, matching Placement::first_touch. Placed pools are sized node by node,
+    // see Placement::topology::pool_size
     template<typename Iterator, typename T>
-    T parallel_accumulate(Iterator first, Iterator last, T init){
+    T parallel_accumulate(Iterator first, Iterator last, T init, unsigned long thread_limit = 0,
+                          Placement::policy placement = Placement::policy::none){
         const auto length = (unsigned long)std::distance(first, last);
         if(!length){
             return init;
         }
         unsigned long const min_per_thread = 25;
         unsigned long const max_threads = (length+min_per_thread-1) / min_per_thread;
-        unsigned long const hardware_threads = std::thread::hardware_concurrency();
-        std::cout << "Hardware threads: " << hardware_threads << std::endl;
-        unsigned long const num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-        std::cout << "Number of threads: " << num_threads << std::endl;
+        unsigned long const hardware_threads = placement == Placement::policy::none ? std::thread::hardware_concurrency()
+                                                                                    : Placement::topology::system().pool_size(placement, thread_limit);
+        Logging::info("Hardware threads: ", hardware_threads);
+        unsigned long const num_threads = std::min({hardware_threads != 0 ? hardware_threads : 2, max_threads,
+                                                    thread_limit != 0 ? thread_limit : max_threads});
+        Logging::info("Number of threads: ", num_threads);
         unsigned long const block_size = length/num_threads;
         std::vector<T> results(num_threads);
-        std::vector<std::thread> threads(num_threads-1);
+        bool const placed = placement != Placement::policy::none;
+        std::vector<std::thread> threads(placed ? num_threads : num_threads-1);
         Iterator block_start = first;
         for(unsigned long i = 0; i < (num_threads - 1); ++i){
             Iterator block_end = block_start;
             std::advance(block_end,block_size);
-            threads[i] = std::thread(accumulate_block<Iterator, T>(), block_start, block_end, std::ref(results[i]));
-            std::cout << "Thread ID: " << threads[i].get_id() << std::endl;
+            threads[i] = Placement::make_thread(placement, static_cast<unsigned>(i), accumulate_block<Iterator, T>(), block_start, block_end, std::ref(results[i]));
+            Logging::info("Thread ID: ", threads[i].get_id());
             block_start = block_end;
         }
-        accumulate_block<Iterator,T>()(block_start,last,results[num_threads-1]);
+        if(placed){
+            threads[num_threads-1] = Placement::make_thread(placement, static_cast<unsigned>(num_threads-1), accumulate_block<Iterator, T>(), block_start, last, std::ref(results[num_threads-1]));
+        } else {
+            accumulate_block<Iterator,T>()(block_start,last,results[num_threads-1]);
+        }
         for(auto& entry: threads){
             entry.join();
         }
         return std::accumulate(results.begin(),results.end(),init);
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
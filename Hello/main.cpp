@@ -4,11 +4,11 @@
 #include "basics.hpp"
 
 void hello(){
-    std::cout << "Hello most basic thread" << std::endl;
+    Logging::info("Hello most basic thread");
 }
 
 void hello_string(const std::string& s){
-    std::cout << "Hello from " << s << std::endl;
+    Logging::info("Hello from ", s);
 }
 
 int main(){
@@ -24,7 +24,7 @@ int main(){
 
     // basic lambda
     std::thread lambda_thread([]{
-        std::cout << "Hello from lambda" << std::endl;
+        Logging::info("Hello from lambda");
     });
     lambda_thread.join();
 
@@ -38,6 +38,7 @@ int main(){
 
     // Joinable thread
     thread_ownership::joining_thread(hello_string, "Joining Thread");
+    thread_ownership::joining_thread(Placement::make_thread(Placement::policy::compact, 0, hello_string, "Pinned Joining Thread"));
 
     // Vector of work threads
     thread_ownership::vector_of_work_threads();
@@ -50,7 +51,7 @@ int main(){
     }
     int initial = 0;
     auto res = threads_at_runtime::parallel_accumulate(v.begin(), v.end(), initial);
-    std::cout << "accumulated value: " << res << std::endl;
+    Logging::info("accumulated value: ", res);
 
 
-}
\ No newline at end of file
+}
\ No newline at end of file
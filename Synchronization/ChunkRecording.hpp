@@ -0,0 +1,326 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Synchronization.hpp"
+
+/*
+ * Binary recording of data_chunk streams
+ *  File layout: one file_header followed by fixed size records, append only
+ *  Every checkpoint_interval chunks a checkpoint record is appended and the mapping is scheduled for write back,
+ *  so a crashed recording is valid up to its last record and can be seeked without scanning
+ *
+ *  chunk_recorder   producer hands chunks to a lock free ring, a writer thread copies them into a growing file mapping
+ *  chunk_replayer   maps the whole file read only and pushes chunks from the mapping straight into a queue
+ */
+
+namespace ChunkRecording{
+
+    inline constexpr char file_magic[8] = {'D', 'C', 'H', 'U', 'N', 'K', 'S', '\0'};
+    inline constexpr std::uint32_t file_version = 1;
+
+    struct file_header{
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t record_size;
+        std::uint32_t checkpoint_interval;
+        std::uint32_t reserved;
+        std::int64_t start_system_ns; // wall clock at the start of the recording
+    };
+
+    enum class record_kind : std::uint32_t { empty = 0, chunk = 1, checkpoint = 2 };
+
+    // chunk:      a = time, b = position, c = orientation
+    // checkpoint: a = chunks recorded so far, b and c unused
+    struct record{
+        record_kind kind;
+        std::uint32_t reserved;
+        std::int64_t offset_ns; // since the start of the recording
+        std::int64_t a;
+        double b;
+        double c;
+    };
+
+    static_assert(sizeof(file_header) == 32);
+    static_assert(sizeof(record) == 40);
+
+    inline std::system_error last_error(const std::string& what){
+        return {errno, std::generic_category(), what};
+    }
+
+    class chunk_recorder{
+    private:
+        static constexpr std::size_t ring_capacity = 1 << 16; // power of two
+        static constexpr std::size_t extent_size = std::size_t(64) << 20; // file grows and is mapped this much at a time
+
+        int fd{-1};
+        std::uint32_t checkpoint_interval;
+        std::chrono::steady_clock::time_point start;
+
+        // Producer -> writer ring
+        std::unique_ptr<record[]> ring{new record[ring_capacity]};
+        alignas(64) std::atomic<std::size_t> head{0};
+        alignas(64) std::atomic<std::size_t> tail{0};
+        alignas(64) std::atomic<std::uint64_t> dropped_count{0};
+
+        // Writer thread state
+        std::byte* window{nullptr};
+        std::size_t window_offset{0}; // file offset of window
+        std::size_t file_length{0};   // bytes of valid data
+        std::uint64_t chunks_written{0};
+        std::exception_ptr writer_error;
+        std::jthread writer;
+
+        void map_window(std::size_t offset){
+            if(window){
+                ::munmap(window, extent_size);
+            }
+            // Reserve real blocks: a sparse extent written through MAP_SHARED raises SIGBUS once the disk is full
+            if(const int err = ::posix_fallocate(fd, static_cast<off_t>(offset), static_cast<off_t>(extent_size)); err != 0){
+                throw std::system_error(err, std::generic_category(), "chunk_recorder: posix_fallocate");
+            }
+            void* p = ::mmap(nullptr, extent_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(offset));
+            if(p == MAP_FAILED){
+                window = nullptr;
+                throw last_error("chunk_recorder: mmap");
+            }
+            window = static_cast<std::byte*>(p);
+            window_offset = offset;
+        }
+
+        void append(const void* src, std::size_t bytes){
+            auto in = static_cast<const std::byte*>(src);
+            while(bytes){
+                std::size_t used = file_length - window_offset;
+                if(used == extent_size){
+                    map_window(file_length);
+                    used = 0;
+                }
+                const std::size_t n = std::min(bytes, extent_size - used);
+                std::memcpy(window + used, in, n);
+                in += n;
+                bytes -= n;
+                file_length += n;
+            }
+        }
+
+        void checkpoint(std::int64_t offset_ns){
+            record r{record_kind::checkpoint, 0, offset_ns, static_cast<std::int64_t>(chunks_written), 0, 0};
+            append(&r, sizeof(r));
+            ::msync(window, file_length - window_offset, MS_ASYNC);
+        }
+
+        // Copies every record visible in the ring into the mapping; returns false when there was nothing
+        bool drain(){
+            const std::size_t t = tail.load(std::memory_order_relaxed);
+            const std::size_t h = head.load(std::memory_order_acquire);
+            if(t == h){
+                return false;
+            }
+            for(std::size_t i = t; i != h;){
+                // Copy contiguous runs of the ring, stopping at the ring wrap and at the next checkpoint
+                const std::size_t slot = i & (ring_capacity - 1);
+                const std::size_t to_checkpoint = checkpoint_interval - chunks_written % checkpoint_interval;
+                const std::size_t n = std::min({h - i, ring_capacity - slot, to_checkpoint});
+                append(&ring[slot], n * sizeof(record));
+                chunks_written += n;
+                i += n;
+                if(n == to_checkpoint){
+                    checkpoint(ring[slot + n - 1].offset_ns);
+                }
+                tail.store(i, std::memory_order_release);
+            }
+            return true;
+        }
+
+        void run(const std::stop_token& stop){
+            try{
+                while(!stop.stop_requested()){
+                    if(!drain()){
+                        std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    }
+                }
+                drain();
+            } catch(...){
+                // Producer keeps going and sees drops; close() reports the failure
+                writer_error = std::current_exception();
+            }
+        }
+
+    public:
+        explicit chunk_recorder(const std::string& path, std::uint32_t checkpoint_interval_ = 4096):
+            checkpoint_interval(checkpoint_interval_ ? checkpoint_interval_ : 1), start(std::chrono::steady_clock::now()){
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if(fd < 0){
+                throw last_error("chunk_recorder: open " + path);
+            }
+            try{
+                map_window(0);
+            } catch(...){
+                ::close(fd);
+                throw;
+            }
+            file_header header{};
+            std::memcpy(header.magic, file_magic, sizeof(file_magic));
+            header.version = file_version;
+            header.record_size = sizeof(record);
+            header.checkpoint_interval = checkpoint_interval;
+            header.start_system_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+            append(&header, sizeof(header));
+            writer = std::jthread([this](std::stop_token st){run(st);});
+        }
+        chunk_recorder(const chunk_recorder&) = delete;
+        chunk_recorder& operator=(const chunk_recorder&) = delete;
+        ~chunk_recorder(){
+            try{
+                close();
+            } catch(...){
+            }
+        }
+
+        // Single producer. Never blocks: when the writer falls a full ring behind the chunk is dropped and counted
+        bool record_chunk(const data_chunk& d) noexcept{
+            const std::size_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) == ring_capacity){
+                dropped_count.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            const auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            ring[h & (ring_capacity - 1)] = record{record_kind::chunk, 0, offset.count(), static_cast<std::int64_t>(d.time), d.position, d.orientation};
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        [[nodiscard]] std::uint64_t dropped() const{
+            return dropped_count.load(std::memory_order_relaxed);
+        }
+
+        // Stops the writer, trims the preallocated tail and closes the file; rethrows a writer failure
+        void close(){
+            if(fd < 0){
+                return;
+            }
+            if(writer.joinable()){
+                writer.request_stop();
+                writer.join();
+            }
+            if(window){
+                ::munmap(window, extent_size);
+                window = nullptr;
+            }
+            [[maybe_unused]] int rc = ::ftruncate(fd, static_cast<off_t>(file_length));
+            ::close(fd);
+            fd = -1;
+            if(writer_error){
+                std::rethrow_exception(writer_error);
+            }
+        }
+    };
+
+    enum class replay_speed { recorded, maximum };
+
+    class chunk_replayer{
+    private:
+        const std::byte* base{nullptr};
+        std::size_t length{0};
+        file_header header{};
+        std::size_t record_count{0}; // chunk and checkpoint records
+
+        [[nodiscard]] record at(std::size_t i) const{
+            record r;
+            std::memcpy(&r, base + sizeof(file_header) + i * sizeof(record), sizeof(record));
+            return r;
+        }
+
+    public:
+        explicit chunk_replayer(const std::string& path){
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0){
+                throw last_error("chunk_replayer: open " + path);
+            }
+            struct stat st{};
+            if(::fstat(fd, &st) != 0){
+                ::close(fd);
+                throw last_error("chunk_replayer: fstat");
+            }
+            length = static_cast<std::size_t>(st.st_size);
+            if(length < sizeof(file_header)){
+                ::close(fd);
+                throw std::runtime_error("chunk_replayer: " + path + " is not a chunk recording");
+            }
+            void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if(p == MAP_FAILED){
+                throw last_error("chunk_replayer: mmap");
+            }
+            base = static_cast<const std::byte*>(p);
+            ::madvise(p, length, MADV_SEQUENTIAL);
+            std::memcpy(&header, base, sizeof(header));
+            if(std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 || header.version != file_version ||
+               header.record_size != sizeof(record) || header.checkpoint_interval == 0){
+                ::munmap(p, length);
+                throw std::runtime_error("chunk_replayer: " + path + " is not a chunk recording");
+            }
+            record_count = (length - sizeof(file_header)) / sizeof(record);
+            // A recording that was not closed still has its preallocated, zero filled tail
+            while(record_count && at(record_count - 1).kind == record_kind::empty){
+                --record_count;
+            }
+        }
+        chunk_replayer(const chunk_replayer&) = delete;
+        chunk_replayer& operator=(const chunk_replayer&) = delete;
+        ~chunk_replayer(){
+            ::munmap(const_cast<std::byte*>(base), length);
+        }
+
+        [[nodiscard]] std::size_t size() const{
+            return record_count - record_count / (header.checkpoint_interval + 1);
+        }
+
+        // Index of the first record at or after the given chunk, found through checkpoint positions
+        [[nodiscard]] std::size_t record_index(std::size_t chunk) const{
+            return chunk + chunk / header.checkpoint_interval;
+        }
+
+        // Pushes chunks [from, size()) into queue; at recorded speed the original spacing is reproduced
+        template<typename Queue>
+        std::size_t replay(Queue& queue, replay_speed speed = replay_speed::maximum, std::size_t from = 0) const{
+            std::size_t pushed = 0;
+            const auto replay_start = std::chrono::steady_clock::now();
+            std::int64_t first_offset = -1;
+            for(std::size_t i = record_index(from); i < record_count; ++i){
+                const record r = at(i);
+                if(r.kind != record_kind::chunk){
+                    continue;
+                }
+                if(speed == replay_speed::recorded){
+                    if(first_offset < 0){
+                        first_offset = r.offset_ns;
+                    }
+                    std::this_thread::sleep_until(replay_start + std::chrono::nanoseconds(r.offset_ns - first_offset));
+                }
+                queue.push(data_chunk(static_cast<std::time_t>(r.a), r.b, r.c));
+                ++pushed;
+            }
+            return pushed;
+        }
+    };
+
+} // ChunkRecording
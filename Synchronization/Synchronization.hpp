@@ -1,12 +1,23 @@
+#pragma once
+
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <stop_token>
+#include <thread>
 
 #include <random>
 #include <chrono>
 
+#include "../Utilities/Logging.hpp"
+#include "../Utilities/Instrumentation.hpp"
+
 struct data_chunk{
     std::time_t time{0};
     double position{0};
@@ -17,9 +28,9 @@ struct data_chunk{
 };
 
 void process(data_chunk d){
-    std::cout << "time: " << d.time << std::endl;
-    std::cout << "position: " << d.position << std::endl;
-    std::cout << "orientation: " << d.orientation << std::endl << std::endl;
+    Logging::info("time: ", d.time);
+    Logging::info("position: ", d.position);
+    Logging::info("orientation: ", d.orientation, "\n");
 };
 
 data_chunk prepare_data(){
@@ -107,63 +118,346 @@ namespace ThreadSafe_Queue_ConditionVariables{
         template<class... Args> void emplace(Args&&... args);
     };*/
 
+    // Pause hint for spin loops
+    inline void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // How consumers of a queue wait for data
+    //  spin_then_park       bounded adaptive spin, then std::atomic::wait; the low latency default
+    //  condition_variable   no spinning, every wait sleeps on a condition variable
+    enum class wake_mode { spin_then_park, condition_variable };
+
+    /*
+     * Waiting shared by the queues. The owner keeps available up to date; in spin_then_park mode waiting
+     * consumers first spin on it for a bounded, adaptive number of iterations and then park in std::atomic::wait
+     * on an epoch counter. std::atomic::wait cannot time out, so timed waits, and every wait in condition_variable
+     * mode, park on a condition variable instead, which is only notified while someone is parked on it.
+     * Owners only wake on an empty -> non-empty transition with a consumer parked, and a consumer that pops while
+     * more elements remain passes the wakeup on, so an idle queue costs no syscalls.
+     */
+    class wakeup{
+    private:
+        using clock = std::chrono::steady_clock;
+
+        static constexpr unsigned min_spin = 16;
+        static constexpr unsigned max_spin = 4096;
+
+        wake_mode wait_mode;
+        std::atomic<std::uint32_t> epoch{0};      // bumped whenever parked consumers should look again
+        std::atomic<unsigned> waiters{0};         // consumers parked on epoch
+        std::atomic<unsigned> cv_waiters{0};      // consumers parked on park_cond
+        std::atomic<unsigned> spin_limit{256};
+        std::mutex park_mutex;
+        std::condition_variable park_cond;
+
+        // Spins until data shows up or the budget runs out; the budget grows when spinning pays off
+        bool spin_for_data(){
+            if(wait_mode == wake_mode::condition_variable){
+                return false;
+            }
+            const unsigned limit = spin_limit.load(std::memory_order_relaxed);
+            for(unsigned i = 0; i < limit; ++i){
+                if(available.load(std::memory_order_relaxed) > 0){
+                    spin_limit.store(std::min(limit * 2, max_spin), std::memory_order_relaxed);
+                    return true;
+                }
+                cpu_relax();
+            }
+            spin_limit.store(std::max(limit / 2, min_spin), std::memory_order_relaxed);
+            return false;
+        }
+
+        // The epoch is read before registering and available checked after, so a push in between either
+        // is seen here or sees this waiter and changes the epoch
+        template<typename Stopped>
+        void park(Stopped stopped){
+            if(wait_mode == wake_mode::condition_variable){
+                park_until(stopped, clock::time_point::max());
+                return;
+            }
+            const std::uint32_t e = epoch.load();
+            waiters.fetch_add(1);
+            if(available.load() <= 0 && !stopped()){
+                epoch.wait(e);
+            }
+            waiters.fetch_sub(1);
+        }
+
+        // Registered and checked under park_mutex, which wake() takes before notifying, so no wakeup is lost
+        template<typename Stopped>
+        void park_until(Stopped stopped, clock::time_point deadline){
+            std::unique_lock<std::mutex> lk(park_mutex);
+            cv_waiters.fetch_add(1);
+            const auto ready = [&]{return available.load() > 0 || stopped();};
+            if(deadline == clock::time_point::max()){
+                park_cond.wait(lk, ready);
+            } else {
+                park_cond.wait_until(lk, deadline, ready);
+            }
+            cv_waiters.fetch_sub(1);
+        }
+
+    public:
+        std::atomic<std::int64_t> available{0}; // elements ready, may dip below zero between a push and its count
+
+        explicit wakeup(wake_mode mode_ = wake_mode::spin_then_park): wait_mode(mode_){}
+        wakeup(const wakeup&) = delete;
+        wakeup& operator=(const wakeup&) = delete;
+
+        [[nodiscard]] wake_mode mode() const{
+            return wait_mode;
+        }
+        [[nodiscard]] bool has_waiters() const{
+            return waiters.load() > 0 || cv_waiters.load() > 0;
+        }
+        void wake(bool all = false){
+            epoch.fetch_add(1);
+            if(all){
+                epoch.notify_all();
+            } else {
+                epoch.notify_one();
+            }
+            if(all || cv_waiters.load() > 0){
+                std::lock_guard<std::mutex> lk(park_mutex);
+                if(all){
+                    park_cond.notify_all();
+                } else {
+                    park_cond.notify_one();
+                }
+            }
+        }
+
+        template<typename TryPop>
+        void wait(TryPop try_pop){
+            while(!try_pop()){
+                if(!spin_for_data()){
+                    park([]{return false;});
+                }
+            }
+        }
+        // Returns false once stop is requested and try_pop finds nothing, so a jthread consumer drains and exits
+        template<typename TryPop>
+        bool wait(TryPop try_pop, const std::stop_token& stop){
+            while(true){
+                if(try_pop()){
+                    return true;
+                }
+                if(stop.stop_requested()){
+                    return false;
+                }
+                if(!spin_for_data()){
+                    std::stop_callback on_stop(stop, [this]{wake(true);});
+                    park([&stop]{return stop.stop_requested();});
+                }
+            }
+        }
+        // Returns false on timeout
+        template<typename TryPop, typename Rep, typename Period>
+        bool wait_for(TryPop try_pop, std::chrono::duration<Rep, Period> timeout){
+            const auto deadline = clock::now() + std::chrono::ceil<clock::duration>(timeout);
+            while(true){
+                if(try_pop()){
+                    return true;
+                }
+                if(clock::now() >= deadline){
+                    return false;
+                }
+                if(!spin_for_data()){
+                    park_until([]{return false;}, deadline);
+                }
+            }
+        }
+    };
+
     // Thread safe queue interface
     template<typename T>
     class threadsafe_queue{
     private:
-        mutable std::mutex mut;
+        using mutex_type = Instrumentation::mutex<std::mutex, "threadsafe_queue::mut">;
+        mutable mutex_type mut;
         std::queue<T> data_queue;
-        std::condition_variable data_cond;
+        [[no_unique_address]] Instrumentation::queue_probe<"threadsafe_queue"> probe;
+        wakeup wait_state; // available mirrors data_queue.size()
+
+        // Caller holds mut; returns whether another parked consumer should be woken
+        bool after_pop(){
+            data_queue.pop();
+            probe.popped();
+            wait_state.available.store(static_cast<std::int64_t>(data_queue.size()));
+            return !data_queue.empty() && wait_state.has_waiters();
+        }
+
     public:
-        threadsafe_queue() = default;
-        threadsafe_queue(const threadsafe_queue& other){
-            std::lock_guard<std::mutex> lk(other.mut);
+        explicit threadsafe_queue(wake_mode mode = wake_mode::spin_then_park): wait_state(mode){}
+        threadsafe_queue(const threadsafe_queue& other): wait_state(other.wait_state.mode()){
+            std::lock_guard<mutex_type> lk(other.mut);
             data_queue= other.data_queue;
+            probe = other.probe;
+            wait_state.available.store(static_cast<std::int64_t>(data_queue.size()));
         }
         //threadsafe_queue& operator=(const threadsafe_queue&) = delete;
         void push(T new_value) {
-            std::lock_guard<std::mutex> lk(mut);
-            data_queue.push(new_value);
-            data_cond.notify_one();
+            bool was_empty;
+            {
+                std::lock_guard<mutex_type> lk(mut);
+                was_empty = data_queue.empty();
+                data_queue.push(std::move(new_value));
+                probe.pushed(data_queue.size());
+                wait_state.available.store(static_cast<std::int64_t>(data_queue.size()));
+            }
+            if(was_empty && wait_state.has_waiters()){
+                wait_state.wake();
+            }
         }
         bool try_pop(T& value){
-            std::lock_guard<std::mutex> lk(mut);
-            if(data_queue.empty()){
-                return false;
+            bool more;
+            {
+                std::lock_guard<mutex_type> lk(mut);
+                if(data_queue.empty()){
+                    return false;
+                }
+                value = std::move(data_queue.front());
+                more = after_pop();
+            }
+            if(more){
+                wait_state.wake();
             }
-            value = data_queue.front();
-            data_queue.pop();
             return true;
         }
         std::shared_ptr<T> try_pop(){
-            std::lock_guard<std::mutex> lk(mut);
-            if(data_queue.empty()){
-                return std::shared_ptr<T>();
+            std::shared_ptr<T> res;
+            bool more;
+            {
+                std::lock_guard<mutex_type> lk(mut);
+                if(data_queue.empty()){
+                    return res;
+                }
+                res = std::make_shared<T>(std::move(data_queue.front()));
+                more = after_pop();
+            }
+            if(more){
+                wait_state.wake();
             }
-            std::shared_ptr<T> res(std::make_shared<T>(data_queue.front()));
-            data_queue.pop();
             return res;
         }
         void wait_and_pop(T& value) {
-            std::unique_lock<std::mutex> lk(mut);
-            data_cond.wait(lk, [this] {return !data_queue.empty();});
-            value = data_queue.front();
-            data_queue.pop();
+            wait_state.wait([&]{return try_pop(value);});
         }
         std::shared_ptr<T> wait_and_pop(){
-            std::unique_lock<std::mutex> lk(mut);
-            data_cond.wait(lk, [this]{return !data_queue.empty();});
-            std::shared_ptr<T> res(std::make_shared<T>(data_queue.front()));
-            data_queue.pop();
+            std::shared_ptr<T> res;
+            wait_state.wait([&]{return static_cast<bool>(res = try_pop());});
             return res;
         }
+        bool wait_and_pop(T& value, const std::stop_token& stop){
+            return wait_state.wait([&]{return try_pop(value);}, stop);
+        }
+        template<typename Rep, typename Period>
+        bool wait_and_pop_for(T& value, std::chrono::duration<Rep, Period> timeout){
+            return wait_state.wait_for([&]{return try_pop(value);}, timeout);
+        }
         [[nodiscard]] bool empty() const{
-            std::lock_guard<std::mutex> lk(mut);
+            std::lock_guard<mutex_type> lk(mut);
             return data_queue.empty();
         }
+        // Lock free, possibly stale
+        [[nodiscard]] std::size_t size_hint() const{
+            return static_cast<std::size_t>(std::max<std::int64_t>(0, wait_state.available.load(std::memory_order_relaxed)));
+        }
+    };
+
+    // Lane for a deadline: overdue goes to lane 0, then one lane per step of remaining slack, the rest to the last
+    template<std::size_t Lanes>
+    std::size_t deadline_lane(std::time_t deadline, std::time_t now, std::time_t step = 1){
+        if(deadline <= now){
+            return 0;
+        }
+        return std::min<std::size_t>(Lanes - 1, 1 + static_cast<std::size_t>((deadline - now - 1) / std::max<std::time_t>(step, 1)));
+    }
+
+    /*
+     * Priority variant with the same surface: one threadsafe_queue per priority lane, lane 0 most urgent,
+     * so producers of different priorities never share a lock. Pops scan lanes in priority order, except
+     * every fairness_interval'th pop which starts at a rotating lane so bulk lanes keep making progress.
+     */
+    template<typename T, std::size_t Lanes = 4>
+    class threadsafe_priority_queue{
+        static_assert(Lanes > 0);
+    private:
+        std::array<threadsafe_queue<T>, Lanes> lanes;
+        wakeup wait_state; // available counts elements over all lanes
+        std::atomic<std::uint64_t> pops{0};
+        const std::uint64_t fairness_interval;
+
+        template<typename Pop>
+        bool pop_any(Pop pop_lane){
+            // Number of the pop this attempt would be; only successful pops count, so failed attempts on an
+            // empty queue do not move the rotation
+            const std::uint64_t n = pops.load(std::memory_order_relaxed) + 1;
+            const std::size_t first = n % fairness_interval == 0 ? static_cast<std::size_t>((n / fairness_interval) % Lanes) : 0;
+            for(std::size_t i = 0; i < Lanes; ++i){
+                auto& lane = lanes[(first + i) % Lanes];
+                if(lane.size_hint() != 0 && pop_lane(lane)){
+                    pops.fetch_add(1, std::memory_order_relaxed);
+                    if(wait_state.available.fetch_sub(1) > 1 && wait_state.has_waiters()){
+                        wait_state.wake();
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+        explicit threadsafe_priority_queue(std::uint64_t fairness_interval_ = 16, wake_mode mode = wake_mode::spin_then_park):
+            wait_state(mode), fairness_interval(std::max<std::uint64_t>(fairness_interval_, 1)){}
+        threadsafe_priority_queue(const threadsafe_priority_queue&) = delete;
+        threadsafe_priority_queue& operator=(const threadsafe_priority_queue&) = delete;
+
+        // Lanes past the last are clamped to it
+        void push(T new_value, std::size_t priority = Lanes - 1){
+            lanes[std::min(priority, Lanes - 1)].push(std::move(new_value));
+            if(wait_state.available.fetch_add(1) <= 0 && wait_state.has_waiters()){
+                wait_state.wake();
+            }
+        }
+        void push_by_deadline(T new_value, std::time_t deadline, std::time_t step = 1){
+            const std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            push(std::move(new_value), deadline_lane<Lanes>(deadline, now, step));
+        }
+        bool try_pop(T& value){
+            return pop_any([&](threadsafe_queue<T>& lane){return lane.try_pop(value);});
+        }
+        std::shared_ptr<T> try_pop(){
+            std::shared_ptr<T> res;
+            pop_any([&](threadsafe_queue<T>& lane){return static_cast<bool>(res = lane.try_pop());});
+            return res;
+        }
+        void wait_and_pop(T& value){
+            wait_state.wait([&]{return try_pop(value);});
+        }
+        std::shared_ptr<T> wait_and_pop(){
+            std::shared_ptr<T> res;
+            wait_state.wait([&]{return static_cast<bool>(res = try_pop());});
+            return res;
+        }
+        bool wait_and_pop(T& value, const std::stop_token& stop){
+            return wait_state.wait([&]{return try_pop(value);}, stop);
+        }
+        template<typename Rep, typename Period>
+        bool wait_and_pop_for(T& value, std::chrono::duration<Rep, Period> timeout){
+            return wait_state.wait_for([&]{return try_pop(value);}, timeout);
+        }
+        [[nodiscard]] bool empty() const{
+            return std::all_of(lanes.begin(), lanes.end(), [](const threadsafe_queue<T>& lane){return lane.empty();});
+        }
     };
 
-    threadsafe_queue<data_chunk> data_queue;
+    threadsafe_queue<data_chunk> data_queue(wake_mode::condition_variable);
 
     int number_of_chunks = 5;
     int number_of_chunks_prepared = 0;
@@ -201,4 +495,4 @@ namespace ThreadSafe_Queue_ConditionVariables{
         }
     }
 
-} // ThreadSafe_Queue_ConditionVariables
\ No newline at end of file
+} // ThreadSafe_Queue_ConditionVariables
\ No newline at end of file
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * Hierarchical timing wheel
+ *  4 levels of 256 slots; level 0 slots are one tick wide, each higher level slot covers a whole lower wheel,
+ *  so with the default 100us tick level 0 spans 25.6ms and level 3 about 5 days. Timers beyond that are parked
+ *  in the last level and cascaded again.
+ *  Timers live in a pool of fixed size node chunks linked into their slot, so schedule and cancel are O(1) and
+ *  growing the pool never moves existing nodes; handles carry a generation so cancelling a timer that already
+ *  fired is harmless. A cancelled periodic timer may still fire once if that firing was already being dispatched.
+ *  A dedicated thread processes ticks at absolute times from the start of the wheel, so periodic timers do not
+ *  drift, and hands due tasks to the dispatcher outside the lock (inline on the timer thread by default, or
+ *  e.g. a push into a threadsafe_queue drained by a pool). Between ticks with work it sleeps straight through,
+ *  so a far away timer costs a handful of wakeups rather than one per tick.
+ */
+
+namespace TimerWheel{
+
+    struct timer_handle{
+        std::uint32_t index{std::numeric_limits<std::uint32_t>::max()};
+        std::uint32_t generation{0};
+    };
+
+    class timer_wheel{
+    public:
+        using clock = std::chrono::steady_clock;
+        using task = std::function<void()>;
+        using dispatcher = std::function<void(task)>;
+
+    private:
+        static constexpr unsigned level_bits = 8;
+        static constexpr std::uint64_t slots_per_level = 1 << level_bits;
+        static constexpr std::uint64_t slot_mask = slots_per_level - 1;
+        static constexpr unsigned levels = 4;
+        static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+        static constexpr unsigned chunk_bits = 12;
+        static constexpr std::uint32_t chunk_size = 1 << chunk_bits;
+
+        struct node{
+            std::uint64_t expiry{0};   // absolute tick
+            std::uint64_t period{0};   // ticks, 0 for one shot
+            std::uint32_t prev{npos};
+            std::uint32_t next{npos};  // also links the free list
+            std::uint32_t bucket{npos};
+            std::uint32_t generation{0};
+            task fn;
+        };
+
+        const clock::duration tick;
+        const clock::time_point start;
+        dispatcher dispatch;
+
+        mutable std::mutex mut;
+        std::condition_variable_any wake;
+        std::vector<std::unique_ptr<node[]>> chunks;
+        std::uint32_t node_count{0};
+        std::array<std::uint32_t, levels * slots_per_level> heads;
+        std::uint32_t free_list{npos};
+        std::uint64_t current{0};   // next tick to process
+        std::size_t active{0};
+        // Tick the timer thread sleeps until; insert only wakes it for a slot processed before that.
+        // 0 while it is processing, the maximum while it waits for the first timer
+        std::uint64_t wake_at{0};
+        std::jthread worker;
+
+        [[nodiscard]] std::uint64_t ticks_until(clock::time_point when) const{
+            if(when <= start){
+                return 0;
+            }
+            // Round up so a timer never fires early
+            return static_cast<std::uint64_t>((when - start + tick - clock::duration(1)) / tick);
+        }
+
+        node& at(std::uint32_t i){
+            return chunks[i >> chunk_bits][i & (chunk_size - 1)];
+        }
+        // Adds a chunk, threaded onto the free list back to front so its nodes are handed out in index order
+        void grow(){
+            chunks.push_back(std::make_unique<node[]>(chunk_size));
+            const std::uint32_t first = node_count;
+            node_count += chunk_size;
+            for(std::uint32_t i = node_count; i-- > first;){
+                at(i).next = free_list;
+                free_list = i;
+            }
+        }
+
+        // Caller holds mut; returns the tick at which the slot the timer went into is processed
+        std::uint64_t link(std::uint32_t i){
+            node& n = at(i);
+            const std::uint64_t expiry = std::max(n.expiry, current);
+            const std::uint64_t delta = expiry - current;
+            unsigned level = 0;
+            while(level + 1 < levels && delta >= (std::uint64_t(1) << (level_bits * (level + 1)))){
+                ++level;
+            }
+            // Past the top level: park in the slot furthest out, it is cascaded again when reached
+            const std::uint64_t placed = level + 1 == levels && delta >= (std::uint64_t(1) << (level_bits * levels))
+                                         ? current + (std::uint64_t(1) << (level_bits * levels)) - 1 : expiry;
+            const std::uint32_t b = static_cast<std::uint32_t>(level * slots_per_level + ((placed >> (level_bits * level)) & slot_mask));
+            n.bucket = b;
+            n.prev = npos;
+            n.next = heads[b];
+            if(n.next != npos){
+                at(n.next).prev = i;
+            }
+            heads[b] = i;
+            return placed >> (level_bits * level) << (level_bits * level);
+        }
+        void unlink(std::uint32_t i){
+            node& n = at(i);
+            if(n.prev != npos){
+                at(n.prev).next = n.next;
+            } else {
+                heads[n.bucket] = n.next;
+            }
+            if(n.next != npos){
+                at(n.next).prev = n.prev;
+            }
+            n.bucket = npos;
+        }
+        void release(std::uint32_t i){
+            node& n = at(i);
+            n.fn = nullptr;
+            ++n.generation;
+            n.next = free_list;
+            free_list = i;
+            --active;
+        }
+        std::uint32_t allocate(){
+            if(free_list == npos){
+                grow();
+            }
+            const std::uint32_t i = free_list;
+            free_list = at(i).next;
+            return i;
+        }
+
+        // Moves every timer of a higher level slot down to where it belongs now
+        void cascade(unsigned level, std::uint64_t slot){
+            std::uint32_t i = heads[level * slots_per_level + slot];
+            heads[level * slots_per_level + slot] = npos;
+            while(i != npos){
+                const std::uint32_t next = at(i).next;
+                link(i);
+                i = next;
+            }
+        }
+
+        // Processes tick current, collecting what is due; caller holds mut
+        void advance(std::vector<task>& due){
+            for(unsigned level = 1; level < levels; ++level){
+                if((current >> (level_bits * (level - 1))) & slot_mask){
+                    break;
+                }
+                cascade(level, (current >> (level_bits * level)) & slot_mask);
+            }
+            const std::uint32_t b = static_cast<std::uint32_t>(current & slot_mask);
+            std::uint32_t i = heads[b];
+            heads[b] = npos;
+            while(i != npos){
+                node& n = at(i);
+                const std::uint32_t next = n.next;
+                n.bucket = npos;
+                if(n.period){
+                    due.push_back(n.fn);
+                    n.expiry += n.period; // from the scheduled tick, not from now, so there is no drift
+                    link(i);
+                } else {
+                    due.push_back(std::move(n.fn));
+                    release(i);
+                }
+                i = next;
+            }
+            ++current;
+        }
+
+        // First tick from current at which a non empty slot is processed: level 0 slots on their own tick,
+        // higher level slots on the tick their cascade runs, which is aligned to the span of one slot
+        [[nodiscard]] std::uint64_t next_due_tick() const{
+            std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+            for(unsigned level = 0; level < levels; ++level){
+                const unsigned shift = level_bits * level;
+                const std::uint64_t span = std::uint64_t(1) << shift;
+                const std::uint64_t first = (current + span - 1) >> shift << shift;
+                for(std::uint64_t k = 0; k < slots_per_level; ++k){
+                    const std::uint64_t t = first + k * span;
+                    if(t >= best){
+                        break;
+                    }
+                    if(heads[level * slots_per_level + ((t >> shift) & slot_mask)] != npos){
+                        best = t;
+                        break;
+                    }
+                }
+            }
+            return best;
+        }
+
+        void run(const std::stop_token& stop){
+            std::vector<task> due;
+            std::unique_lock<std::mutex> lk(mut);
+            while(!stop.stop_requested()){
+                if(active == 0){
+                    // Nothing pending: sleep until something is scheduled, insert moves current forward
+                    wake_at = std::numeric_limits<std::uint64_t>::max();
+                    wake.wait(lk, stop, [this]{return active != 0;});
+                    wake_at = 0;
+                    continue;
+                }
+                const std::uint64_t next = next_due_tick();
+                const clock::time_point next_time = start + tick * static_cast<clock::rep>(next);
+                if(clock::now() < next_time){
+                    wake_at = next;
+                    wake.wait_until(lk, stop, next_time, [this, next]{return wake_at != next;});
+                    wake_at = 0;
+                    continue;
+                }
+                // Every slot processed before next is empty, so those ticks can be skipped outright
+                current = std::max(current, next);
+                // Catch up on every tick whose time has been reached
+                const std::uint64_t now_tick = static_cast<std::uint64_t>((clock::now() - start) / tick);
+                while(current <= now_tick && active != 0){
+                    advance(due);
+                }
+                current = std::max(current, now_tick + 1);
+                lk.unlock();
+                for(auto& t: due){
+                    dispatch(std::move(t));
+                }
+                due.clear();
+                lk.lock();
+            }
+        }
+
+        timer_handle insert(std::uint64_t expiry, std::uint64_t period, task t){
+            timer_handle h;
+            {
+                std::lock_guard<std::mutex> lk(mut);
+                if(active == 0){
+                    // The idle wheel stopped ticking; with no timers in the slots it can jump straight to now
+                    current = std::max(current, ticks_until(clock::now()));
+                }
+                const std::uint32_t i = allocate();
+                node& n = at(i);
+                n.expiry = expiry;
+                n.period = period;
+                n.fn = std::move(t);
+                const std::uint64_t due = link(i);
+                ++active;
+                h = {i, n.generation};
+                if(due >= wake_at){
+                    return h;
+                }
+                wake_at = due;
+            }
+            wake.notify_one();
+            return h;
+        }
+
+    public:
+        explicit timer_wheel(dispatcher d = {}, clock::duration tick_ = std::chrono::microseconds(100)):
+            tick(tick_ > clock::duration::zero() ? tick_ : clock::duration(1)), start(clock::now()),
+            dispatch(d ? std::move(d) : dispatcher([](task t){t();})){
+            heads.fill(npos);
+            worker = std::jthread([this](std::stop_token st){run(st);});
+        }
+        timer_wheel(const timer_wheel&) = delete;
+        timer_wheel& operator=(const timer_wheel&) = delete;
+        // Pending timers are dropped
+        ~timer_wheel(){
+            worker.request_stop();
+            worker.join();
+        }
+
+        timer_handle schedule_at(clock::time_point when, task t){
+            return insert(ticks_until(when), 0, std::move(t));
+        }
+        timer_handle schedule_after(clock::duration delay, task t){
+            return schedule_at(clock::now() + delay, std::move(t));
+        }
+        // First firing after one period unless first_delay is given, then every period from the scheduled time
+        timer_handle schedule_every(clock::duration period, task t, clock::duration first_delay = clock::duration::min()){
+            const std::uint64_t period_ticks = std::max<std::uint64_t>(1, ticks_until(start + period));
+            const auto first = clock::now() + (first_delay == clock::duration::min() ? period : first_delay);
+            return insert(ticks_until(first), period_ticks, std::move(t));
+        }
+
+        // Grows the node pool up front so scheduling up to timers at once never allocates under the lock
+        void reserve(std::size_t timers){
+            std::lock_guard<std::mutex> lk(mut);
+            while(node_count < timers){
+                grow();
+            }
+        }
+
+        // False when the timer already fired (one shot) or was cancelled. True stops every later firing, but a
+        // periodic task already taken off the wheel for dispatch may still run once after this returns
+        bool cancel(timer_handle h){
+            std::lock_guard<std::mutex> lk(mut);
+            if(h.index >= node_count){
+                return false;
+            }
+            node& n = at(h.index);
+            if(n.generation != h.generation || n.bucket == npos){
+                return false;
+            }
+            unlink(h.index);
+            release(h.index);
+            return true;
+        }
+
+        [[nodiscard]] std::size_t pending() const{
+            std::lock_guard<std::mutex> lk(mut);
+            return active;
+        }
+        [[nodiscard]] clock::duration resolution() const{
+            return tick;
+        }
+    };
+
+} // TimerWheel
@@ -1,24 +1,99 @@
 #include <iostream>
 #include <thread>
 #include <random>
+#include <filesystem>
+#include <atomic>
+#include <latch>
 
 #include "Synchronization.hpp"
+#include "ChunkRecording.hpp"
+#include "TimerWheel.hpp"
 
 int main(){
     // Condition variable
     {
-        std::cout << "Condition Variable" << std::endl;
+        Logging::info("Condition Variable");
         auto prep_thread = std::jthread(ConditionVariables::data_preparation_thread);
         auto proc_thread = std::jthread(ConditionVariables::data_processing_thread);
     }
 
     // Threadsafe queue with Condition variable
     {
-        std::cout << "Threadsafe queue with Condition variable" << std::endl;
+        Logging::info("Threadsafe queue with Condition variable");
         auto prep_thread = std::jthread(ThreadSafe_Queue_ConditionVariables::data_preparation_thread);
         auto proc_thread = std::jthread(ThreadSafe_Queue_ConditionVariables::data_processing_thread);
     }
 
+    // Record a data_chunk stream and replay it through a threadsafe queue at the recorded pace
+    {
+        Logging::info("Recorded data_chunk replay");
+        const auto path = (std::filesystem::temp_directory_path() / "data_chunks.rec").string();
+        {
+            ChunkRecording::chunk_recorder recorder(path);
+            for(int i = 0; i < 5; ++i){
+                recorder.record_chunk(prepare_data());
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        ChunkRecording::chunk_replayer replayer(path);
+        ThreadSafe_Queue_ConditionVariables::threadsafe_queue<data_chunk> replay_queue;
+        // The consumer drains the queue and exits once stopped, no sentinel chunk needed
+        auto proc_thread = std::jthread([&](std::stop_token stop){
+            data_chunk data;
+            while(replay_queue.wait_and_pop(data, stop)){
+                process(data);
+            }
+        });
+        replayer.replay(replay_queue, ChunkRecording::replay_speed::recorded);
+        proc_thread.request_stop();
+        proc_thread.join();
+        std::filesystem::remove(path);
+    }
+
+    // Chunks keyed by deadline: each lands in the lane for its slack, so sooner deadlines are processed first;
+    // chunks with more slack than the last lane covers stay in arrival order
+    {
+        Logging::info("Deadline priority queue");
+        ThreadSafe_Queue_ConditionVariables::threadsafe_priority_queue<data_chunk> priority_queue;
+        for(int i = 4; i >= 0; --i){
+            data_chunk data = prepare_data();
+            data.time += i;
+            priority_queue.push_by_deadline(data, data.time);
+        }
+        data_chunk data;
+        while(priority_queue.try_pop(data)){
+            process(data);
+        }
+    }
+
+    // Chunks prepared at a fixed cadence by a timer wheel instead of a tight producer loop
+    {
+        Logging::info("Timer wheel cadence");
+        ThreadSafe_Queue_ConditionVariables::threadsafe_queue<data_chunk> cadence_queue;
+        std::atomic<int> remaining{5};
+        std::latch produced(5);
+        TimerWheel::timer_wheel wheel;
+        auto proc_thread = std::jthread([&](std::stop_token stop){
+            data_chunk data;
+            while(cadence_queue.wait_and_pop(data, stop)){
+                process(data);
+            }
+        });
+        const auto timer = wheel.schedule_every(std::chrono::milliseconds(20), [&]{
+            if(remaining.fetch_sub(1) > 0){
+                cadence_queue.push(prepare_data());
+                produced.count_down();
+            }
+        });
+        produced.wait();
+        wheel.cancel(timer);
+        proc_thread.request_stop();
+    }
+
+    if constexpr(Instrumentation::enabled){
+        Instrumentation::dump_json(std::cerr);
+    }
+
 
 
-}
\ No newline at end of file
+}
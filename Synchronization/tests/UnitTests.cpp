@@ -1,5 +1,22 @@
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Synchronization.hpp"
+#include "ChunkRecording.hpp"
+#include "TimerWheel.hpp"
+
 // Demonstrate some basic assertions.
 TEST(HelloTest, BasicAssertions) {
     // Expect two strings not to be equal.
@@ -8,9 +25,444 @@ TEST(HelloTest, BasicAssertions) {
     EXPECT_EQ(7 * 6, 42);
 }
 
+// Each logger drains only its own rings, so a thread writing through it ends up in its stream
+TEST(LoggingTest, LoggerWritesToItsOwnStream) {
+    std::stringstream out;
+    {
+        Logging::logger mine(out);
+        mine.write(Logging::level::info, "value ", 42);
+        mine.write(Logging::level::warn, "careful");
+    }
+    EXPECT_EQ(out.str(), "value 42\n[warn] careful\n");
+}
+
+// A thread whose first write went through a logger that is gone must not keep feeding that logger's ring:
+// once the ring filled up nobody would drain it and write() would spin forever
+TEST(LoggingTest, RingsAreKeptPerLogger) {
+    std::stringstream first_out, second_out;
+    const int lines = 4 * static_cast<int>(Logging::thread_buffer::capacity);
+    std::thread writer([&]{
+        {
+            Logging::logger first(first_out);
+            first.write(Logging::level::info, "first");
+        }
+        Logging::logger second(second_out);
+        for(int i = 0; i < lines; ++i){
+            second.write(Logging::level::info, i);
+        }
+    });
+    writer.join();
+    EXPECT_EQ(first_out.str(), "first\n");
+    int count = 0;
+    for(std::string line; std::getline(second_out, line);){
+        EXPECT_EQ(line, std::to_string(count));
+        ++count;
+    }
+    EXPECT_EQ(count, lines);
+}
+
+// Character pointers are copied when captured; the buffers behind them may be gone before the flusher runs
+TEST(LoggingTest, CharacterPointersAreCapturedByValue) {
+    std::stringstream out;
+    {
+        Logging::logger mine(out);
+        std::string text = "captured";
+        char buffer[] = "buffer";
+        mine.write(Logging::level::info, text.c_str(), " ", buffer);
+        text.assign(64, 'x');
+        buffer[0] = 'B';
+    }
+    EXPECT_EQ(out.str(), "captured buffer\n");
+}
+
+namespace {
+
+    std::string temp_recording(const std::string& name){
+        return (std::filesystem::temp_directory_path() / (name + ".rec")).string();
+    }
+
+    std::vector<data_chunk> drain(ThreadSafe_Queue_ConditionVariables::threadsafe_queue<data_chunk>& queue){
+        std::vector<data_chunk> out;
+        data_chunk d;
+        while(queue.try_pop(d)){
+            out.push_back(d);
+        }
+        return out;
+    }
+
+} // namespace
+
+// Chunks go through the file bit for bit, in order, with checkpoints in between that are not replayed
+TEST(ChunkRecordingTest, RoundTrip) {
+    const auto path = temp_recording("chunk_round_trip");
+    const std::size_t count = 10;
+    {
+        ChunkRecording::chunk_recorder recorder(path, 4);
+        for(std::size_t i = 0; i < count; ++i){
+            ASSERT_TRUE(recorder.record_chunk(data_chunk(static_cast<std::time_t>(1000 + i), 0.5 * i, -1.25 * i)));
+        }
+        recorder.close();
+        EXPECT_EQ(recorder.dropped(), 0u);
+    }
+    // 10 chunks and a checkpoint after every 4th
+    EXPECT_EQ(std::filesystem::file_size(path), sizeof(ChunkRecording::file_header) + (count + 2) * sizeof(ChunkRecording::record));
+
+    ChunkRecording::chunk_replayer replayer(path);
+    EXPECT_EQ(replayer.size(), count);
+    ThreadSafe_Queue_ConditionVariables::threadsafe_queue<data_chunk> queue;
+    EXPECT_EQ(replayer.replay(queue), count);
+    const auto chunks = drain(queue);
+    ASSERT_EQ(chunks.size(), count);
+    for(std::size_t i = 0; i < count; ++i){
+        EXPECT_EQ(chunks[i].time, static_cast<std::time_t>(1000 + i));
+        EXPECT_EQ(chunks[i].position, 0.5 * i);
+        EXPECT_EQ(chunks[i].orientation, -1.25 * i);
+    }
+    std::filesystem::remove(path);
+}
+
+// Seeking goes through the checkpoint positions, on and off a checkpoint boundary
+TEST(ChunkRecordingTest, ReplayFrom) {
+    const auto path = temp_recording("chunk_replay_from");
+    {
+        ChunkRecording::chunk_recorder recorder(path, 4);
+        for(int i = 0; i < 10; ++i){
+            recorder.record_chunk(data_chunk(i, 0, 0));
+        }
+    }
+    ChunkRecording::chunk_replayer replayer(path);
+    for(std::size_t from: {0u, 3u, 4u, 5u, 8u, 9u, 10u}){
+        ThreadSafe_Queue_ConditionVariables::threadsafe_queue<data_chunk> queue;
+        EXPECT_EQ(replayer.replay(queue, ChunkRecording::replay_speed::maximum, from), 10 - from);
+        const auto chunks = drain(queue);
+        if(!chunks.empty()){
+            EXPECT_EQ(chunks.front().time, static_cast<std::time_t>(from));
+            EXPECT_EQ(chunks.back().time, 9);
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(ChunkRecordingTest, RejectsForeignAndCorruptFiles) {
+    const auto path = temp_recording("chunk_corrupt");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "not a recording";
+    }
+    EXPECT_THROW(ChunkRecording::chunk_replayer{path}, std::runtime_error);
+
+    {
+        ChunkRecording::chunk_recorder recorder(path, 4);
+        recorder.record_chunk(data_chunk(1, 2, 3));
+    }
+    // Zero the header's checkpoint interval
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        const std::uint32_t zero = 0;
+        file.seekp(offsetof(ChunkRecording::file_header, checkpoint_interval));
+        file.write(reinterpret_cast<const char*>(&zero), sizeof(zero));
+    }
+    EXPECT_THROW(ChunkRecording::chunk_replayer{path}, std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+namespace {
+
+    using wheel_clock = TimerWheel::timer_wheel::clock;
+
+    // Polls until the callbacks have run the expected number of times or the deadline passes. pending() alone
+    // is not enough, it drops to zero before the last due callback is dispatched outside the lock
+    bool wait_for_fired(const std::atomic<int>& fired, int expected, wheel_clock::time_point deadline){
+        while(fired.load() < expected && wheel_clock::now() < deadline){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return fired.load() >= expected;
+    }
+
+    struct firing_log{
+        std::atomic<int> fired{0};
+        std::atomic<int> early{0};
+
+        TimerWheel::timer_wheel::task expect_at(wheel_clock::time_point due){
+            return [this, due]{
+                if(wheel_clock::now() < due){
+                    ++early;
+                }
+                ++fired;
+            };
+        }
+    };
+
+} // namespace
+
+// Delays up to 150000 ticks land in levels 0 to 2 and have to cascade down before they fire
+TEST(TimerWheelTest, CascadedTimersAllFireNoneEarly) {
+    TimerWheel::timer_wheel wheel({}, std::chrono::microseconds(10));
+    firing_log log;
+    const int count = 20000;
+    wheel.reserve(count);
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> delay_us(0, 1500000);
+    for(int i = 0; i < count; ++i){
+        const auto due = wheel_clock::now() + std::chrono::microseconds(delay_us(gen));
+        wheel.schedule_at(due, log.expect_at(due));
+    }
+    ASSERT_TRUE(wait_for_fired(log.fired, count, wheel_clock::now() + std::chrono::seconds(10)));
+    EXPECT_EQ(wheel.pending(), 0u);
+    EXPECT_EQ(log.fired.load(), count);
+    EXPECT_EQ(log.early.load(), 0);
+}
+
+// Past 2^32 ticks a timer is parked in the furthest top level slot and cascaded again from there;
+// a 1ns tick keeps that within a few seconds
+TEST(TimerWheelTest, TimerBeyondTopLevelIsReparked) {
+    TimerWheel::timer_wheel wheel({}, std::chrono::nanoseconds(1));
+    firing_log log;
+    const auto due = wheel_clock::now() + std::chrono::nanoseconds(std::uint64_t(1) << 32) + std::chrono::milliseconds(100);
+    wheel.schedule_at(due, log.expect_at(due));
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    EXPECT_EQ(log.fired.load(), 0);
+    EXPECT_EQ(wheel.pending(), 1u);
+    ASSERT_TRUE(wait_for_fired(log.fired, 1, due + std::chrono::seconds(5)));
+    EXPECT_EQ(wheel.pending(), 0u);
+    EXPECT_EQ(log.fired.load(), 1);
+    EXPECT_EQ(log.early.load(), 0);
+}
+
+TEST(TimerWheelTest, CancelIsGenerationChecked) {
+    TimerWheel::timer_wheel wheel;
+    std::atomic<int> fired{0};
+
+    const auto cancelled = wheel.schedule_after(std::chrono::milliseconds(20), [&]{fired += 100;});
+    EXPECT_TRUE(wheel.cancel(cancelled));
+    EXPECT_FALSE(wheel.cancel(cancelled));
+    EXPECT_EQ(wheel.pending(), 0u);
+
+    // The freed node is handed out again; the old handle must not reach the new timer
+    const auto reused = wheel.schedule_after(std::chrono::milliseconds(20), [&]{++fired;});
+    EXPECT_EQ(reused.index, cancelled.index);
+    EXPECT_NE(reused.generation, cancelled.generation);
+    EXPECT_FALSE(wheel.cancel(cancelled));
+
+    ASSERT_TRUE(wait_for_fired(fired, 1, wheel_clock::now() + std::chrono::seconds(5)));
+    EXPECT_EQ(wheel.pending(), 0u);
+    EXPECT_EQ(fired.load(), 1);
+    // A one shot that already fired can no longer be cancelled
+    EXPECT_FALSE(wheel.cancel(reused));
+    EXPECT_FALSE(wheel.cancel(TimerWheel::timer_handle{}));
+}
+
+TEST(TimerWheelTest, PeriodicTimerKeepsCadenceUntilCancelled) {
+    TimerWheel::timer_wheel wheel;
+    std::atomic<int> fired{0};
+    const auto scheduled = wheel_clock::now();
+    const auto every = wheel.schedule_every(std::chrono::milliseconds(10), [&]{++fired;});
+    std::this_thread::sleep_for(std::chrono::milliseconds(205));
+    EXPECT_TRUE(wheel.cancel(every));
+    const int at_cancel = fired.load();
+    // Fires at 10, 20, ... from the schedule, so never more often than that however late the cancel comes
+    const auto elapsed = wheel_clock::now() - scheduled;
+    EXPECT_LE(at_cancel, elapsed / std::chrono::milliseconds(10));
+    EXPECT_GE(at_cancel, 10);
+    // A dispatch already taken off the wheel when cancel ran may still land, but nothing after it
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_LE(fired.load(), at_cancel + 1);
+}
+
+namespace {
+
+    using ThreadSafe_Queue_ConditionVariables::threadsafe_queue;
+    using ThreadSafe_Queue_ConditionVariables::wake_mode;
+
+    std::string wake_mode_name(const testing::TestParamInfo<wake_mode>& info){
+        return info.param == wake_mode::spin_then_park ? "SpinThenPark" : "ConditionVariable";
+    }
+
+} // namespace
+
+// The waiting paths under both wake modes
+class ThreadsafeQueueTest : public testing::TestWithParam<wake_mode> {};
+
+// Elements pushed before the stop are still handed out, then the wait reports the stop
+TEST_P(ThreadsafeQueueTest, StopTokenWaitDrainsThenReturnsFalse) {
+    threadsafe_queue<int> queue(GetParam());
+    for(int i = 0; i < 100; ++i){
+        queue.push(i);
+    }
+    std::stop_source stop;
+    stop.request_stop();
+    std::vector<int> popped;
+    int value;
+    while(queue.wait_and_pop(value, stop.get_token())){
+        popped.push_back(value);
+    }
+    ASSERT_EQ(popped.size(), 100u);
+    for(int i = 0; i < 100; ++i){
+        EXPECT_EQ(popped[i], i);
+    }
+}
+
+// A consumer parked on an empty queue is woken by request_stop, no sentinel element needed
+TEST_P(ThreadsafeQueueTest, StopTokenWakesParkedConsumer) {
+    threadsafe_queue<int> queue(GetParam());
+    std::atomic<int> consumed{0};
+    std::atomic<bool> finished{false};
+    std::jthread consumer([&](std::stop_token stop){
+        int value;
+        while(queue.wait_and_pop(value, stop)){
+            ++consumed;
+        }
+        finished = true;
+    });
+    queue.push(1);
+    queue.push(2);
+    // Let the consumer drain and park
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(consumed.load() < 2 && std::chrono::steady_clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(finished.load());
+    consumer.request_stop();
+    consumer.join();
+    EXPECT_TRUE(finished.load());
+    EXPECT_EQ(consumed.load(), 2);
+}
+
+TEST_P(ThreadsafeQueueTest, TimedWaitTimesOut) {
+    threadsafe_queue<int> queue(GetParam());
+    int value;
+    const auto began = std::chrono::steady_clock::now();
+    EXPECT_FALSE(queue.wait_and_pop_for(value, std::chrono::milliseconds(30)));
+    EXPECT_GE(std::chrono::steady_clock::now() - began, std::chrono::milliseconds(30));
+}
+
+// A push in the middle of a long timed wait ends it right away instead of at the next poll or the deadline
+TEST_P(ThreadsafeQueueTest, TimedWaitReturnsOnPush) {
+    threadsafe_queue<int> queue(GetParam());
+    std::jthread producer([&]{
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        queue.push(7);
+    });
+    int value = 0;
+    const auto began = std::chrono::steady_clock::now();
+    EXPECT_TRUE(queue.wait_and_pop_for(value, std::chrono::seconds(10)));
+    EXPECT_LT(std::chrono::steady_clock::now() - began, std::chrono::seconds(2));
+    EXPECT_EQ(value, 7);
+}
+
+// Producers burst while several consumers are parked, so woken consumers have to pass the wakeup on;
+// every element arrives exactly once
+TEST_P(ThreadsafeQueueTest, ManyProducersManyConsumers) {
+    threadsafe_queue<int> queue(GetParam());
+    const int producers = 4, consumers = 4, per_producer = 20000;
+    const int total = producers * per_producer;
+    std::vector<std::atomic<int>> seen(total);
+    std::atomic<int> consumed{0};
+    std::vector<std::jthread> consumer_threads;
+    for(int c = 0; c < consumers; ++c){
+        consumer_threads.emplace_back([&](std::stop_token stop){
+            int value;
+            while(queue.wait_and_pop(value, stop)){
+                ++seen[value];
+                ++consumed;
+            }
+        });
+    }
+    {
+        std::vector<std::jthread> producer_threads;
+        for(int p = 0; p < producers; ++p){
+            producer_threads.emplace_back([&, p]{
+                for(int i = 0; i < per_producer; ++i){
+                    queue.push(p * per_producer + i);
+                    if(i % 1000 == 999){
+                        // Let the consumers run dry and park between bursts
+                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    }
+                }
+            });
+        }
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while(consumed.load() < total && std::chrono::steady_clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    consumer_threads.clear();
+    EXPECT_EQ(consumed.load(), total);
+    for(int i = 0; i < total; ++i){
+        ASSERT_EQ(seen[i].load(), 1) << "element " << i;
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+INSTANTIATE_TEST_SUITE_P(WakeModes, ThreadsafeQueueTest,
+                         testing::Values(wake_mode::spin_then_park, wake_mode::condition_variable), wake_mode_name);
+
+TEST(DeadlineLaneTest, MapsSlackToLanes) {
+    using ThreadSafe_Queue_ConditionVariables::deadline_lane;
+    const std::time_t now = 1000;
+    // Overdue and due now go to the most urgent lane
+    EXPECT_EQ(deadline_lane<4>(now - 5, now), 0u);
+    EXPECT_EQ(deadline_lane<4>(now, now), 0u);
+    // One lane per step of slack
+    EXPECT_EQ(deadline_lane<4>(now + 1, now), 1u);
+    EXPECT_EQ(deadline_lane<4>(now + 2, now), 2u);
+    EXPECT_EQ(deadline_lane<4>(now + 3, now), 3u);
+    EXPECT_EQ(deadline_lane<4>(now + 10, now, 10), 1u);
+    EXPECT_EQ(deadline_lane<4>(now + 11, now, 10), 2u);
+    EXPECT_EQ(deadline_lane<4>(now + 20, now, 10), 2u);
+    // Slack beyond the last lane stays in the last lane
+    EXPECT_EQ(deadline_lane<4>(now + 1000, now), 3u);
+    EXPECT_EQ(deadline_lane<4>(now + 31, now, 10), 3u);
+    // A non positive step counts as 1
+    EXPECT_EQ(deadline_lane<4>(now + 2, now, 0), 2u);
+}
+
+// Without a fairness turn due, lanes come out in priority order and each lane in FIFO order
+TEST(ThreadsafePriorityQueueTest, PopsInLaneOrder) {
+    ThreadSafe_Queue_ConditionVariables::threadsafe_priority_queue<int, 4> queue(1000);
+    for(int i = 0; i < 3; ++i){
+        for(std::size_t lane = 4; lane-- > 0;){
+            queue.push(static_cast<int>(lane) * 10 + i, lane);
+        }
+    }
+    // Past the last lane is clamped to it
+    queue.push(99, 17);
+    std::vector<int> popped;
+    int value;
+    while(queue.try_pop(value)){
+        popped.push_back(value);
+    }
+    EXPECT_EQ(popped, (std::vector<int>{0, 1, 2, 10, 11, 12, 20, 21, 22, 30, 31, 32, 99}));
+    EXPECT_TRUE(queue.empty());
+}
+
+// Under constant lane 0 load the bulk lane still gets a turn within fairness_interval * Lanes pops,
+// and attempts on an empty queue do not count towards the rotation
+TEST(ThreadsafePriorityQueueTest, BulkLaneProgressesUnderUrgentLoad) {
+    const std::uint64_t fairness_interval = 8;
+    const std::size_t lanes = 4;
+    ThreadSafe_Queue_ConditionVariables::threadsafe_priority_queue<int, lanes> queue(fairness_interval);
+    int value;
+    for(int i = 0; i < 100; ++i){
+        EXPECT_FALSE(queue.try_pop(value));
+    }
+    queue.push(-1, lanes - 1);
+    std::size_t pops = 0;
+    bool bulk_popped = false;
+    while(!bulk_popped && pops < fairness_interval * lanes){
+        queue.push(static_cast<int>(pops), 0);
+        ASSERT_TRUE(queue.try_pop(value));
+        ++pops;
+        bulk_popped = value == -1;
+    }
+    EXPECT_TRUE(bulk_popped);
+    // The first fairness turn starts at lane 1 and skips the empty lanes up to the bulk one; had the 100
+    // failed attempts counted, the turn would have come early
+    EXPECT_EQ(pops, fairness_interval);
+}
 
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
-
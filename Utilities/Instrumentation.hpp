@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <type_traits>
+
+/*
+ * Lock contention and queue latency instrumentation
+ *  Instrumentation::mutex<M, "name">             M, or a wrapper recording acquire wait, hold time and contention
+ *  Instrumentation::queue_probe<"name">          records depth on push and enqueue to dequeue latency on pop
+ *  Instrumentation::dump_json(os)                writes every site that has been used
+ *
+ * Everything compiles down to the plain types unless INSTRUMENTATION_ENABLED is defined
+ * (cmake -DENABLE_INSTRUMENTATION=ON). All instances sharing a name share one site.
+ * Each site keeps log linear histograms split into per thread shards, updated with relaxed atomics
+ * and summed when dumped, so recording never takes a lock.
+ */
+
+namespace Instrumentation{
+
+#ifdef INSTRUMENTATION_ENABLED
+    inline constexpr bool enabled = true;
+#else
+    inline constexpr bool enabled = false;
+#endif
+
+    // String literal usable as a template argument, names a site
+    template<std::size_t N>
+    struct site_name{
+        char value[N]{};
+        constexpr site_name(const char (&s)[N]){ std::copy_n(s, N, value); }
+    };
+
+    using clock = std::chrono::steady_clock;
+
+    inline std::uint64_t elapsed_ns(clock::time_point from, clock::time_point to){
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+
+    inline constexpr std::size_t shard_count = 16;
+
+    // Threads are spread over the shards round robin, sharing only once there are more threads than shards
+    inline std::size_t thread_shard(){
+        static std::atomic<std::size_t> next{0};
+        thread_local const std::size_t shard = next.fetch_add(1, std::memory_order_relaxed) % shard_count;
+        return shard;
+    }
+
+    // HDR style histogram: 8 linear sub buckets per power of two, about 12% relative error, values up to 2^44
+    class histogram{
+    public:
+        static constexpr unsigned sub_bits = 3;
+        static constexpr std::uint64_t sub_count = 1 << sub_bits;
+        static constexpr unsigned max_bits = 44;
+        static constexpr std::size_t bucket_count = (max_bits - sub_bits + 1) * sub_count;
+
+        static constexpr std::size_t index(std::uint64_t v){
+            if(v < sub_count){
+                return static_cast<std::size_t>(v);
+            }
+            const unsigned shift = static_cast<unsigned>(std::bit_width(v)) - 1 - sub_bits;
+            const std::size_t i = (shift + 1) * sub_count + static_cast<std::size_t>((v >> shift) - sub_count);
+            return std::min(i, bucket_count - 1);
+        }
+        // Smallest value that lands in bucket i
+        static constexpr std::uint64_t lower_bound(std::size_t i){
+            if(i < sub_count){
+                return i;
+            }
+            const std::size_t shift = i / sub_count - 1;
+            return (sub_count + i % sub_count) << shift;
+        }
+
+        struct snapshot{
+            std::array<std::uint64_t, bucket_count> counts{};
+            std::uint64_t total{0};
+            std::uint64_t sum{0};
+            std::uint64_t max{0};
+
+            [[nodiscard]] std::uint64_t percentile(double q) const{
+                if(!total){
+                    return 0;
+                }
+                const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(total - 1)) + 1;
+                std::uint64_t seen = 0;
+                for(std::size_t i = 0; i < bucket_count; ++i){
+                    seen += counts[i];
+                    if(seen >= rank){
+                        return std::min(lower_bound(i), max);
+                    }
+                }
+                return max;
+            }
+            void write_json(std::ostream& os) const{
+                os << "{\"count\":" << total
+                   << ",\"mean\":" << (total ? sum / total : 0)
+                   << ",\"p50\":" << percentile(0.50)
+                   << ",\"p90\":" << percentile(0.90)
+                   << ",\"p99\":" << percentile(0.99)
+                   << ",\"p999\":" << percentile(0.999)
+                   << ",\"max\":" << max << "}";
+            }
+        };
+
+    private:
+        struct alignas(64) shard{
+            std::array<std::atomic<std::uint64_t>, bucket_count> counts{};
+            std::atomic<std::uint64_t> sum{0};
+            std::atomic<std::uint64_t> max{0};
+        };
+        std::array<shard, shard_count> shards;
+
+    public:
+        void record(std::uint64_t v){
+            shard& s = shards[thread_shard()];
+            s.counts[index(v)].fetch_add(1, std::memory_order_relaxed);
+            s.sum.fetch_add(v, std::memory_order_relaxed);
+            std::uint64_t m = s.max.load(std::memory_order_relaxed);
+            while(v > m && !s.max.compare_exchange_weak(m, v, std::memory_order_relaxed)){}
+        }
+
+        [[nodiscard]] snapshot merge() const{
+            snapshot out;
+            for(const shard& s: shards){
+                for(std::size_t i = 0; i < bucket_count; ++i){
+                    const std::uint64_t c = s.counts[i].load(std::memory_order_relaxed);
+                    out.counts[i] += c;
+                    out.total += c;
+                }
+                out.sum += s.sum.load(std::memory_order_relaxed);
+                out.max = std::max(out.max, s.max.load(std::memory_order_relaxed));
+            }
+            return out;
+        }
+    };
+
+    // Per thread sharded event counter
+    class counter{
+        struct alignas(64) shard{
+            std::atomic<std::uint64_t> value{0};
+        };
+        std::array<shard, shard_count> shards;
+    public:
+        void increment(){
+            shards[thread_shard()].value.fetch_add(1, std::memory_order_relaxed);
+        }
+        [[nodiscard]] std::uint64_t load() const{
+            std::uint64_t total = 0;
+            for(const shard& s: shards){
+                total += s.value.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+    };
+
+    // Sites link themselves into a push only list the first time they are used
+    class site{
+    public:
+        const char* name;
+        site* next{nullptr};
+
+        explicit site(const char* n): name(n){}
+        site(const site&) = delete;
+        site& operator=(const site&) = delete;
+        virtual ~site() = default;
+        virtual void write_json(std::ostream& os) const = 0;
+        [[nodiscard]] virtual bool is_lock() const = 0;
+
+        static std::atomic<site*>& registry(){
+            static std::atomic<site*> head{nullptr};
+            return head;
+        }
+    protected:
+        void register_site(){
+            site* h = registry().load(std::memory_order_relaxed);
+            do{
+                next = h;
+            } while(!registry().compare_exchange_weak(h, this, std::memory_order_release, std::memory_order_relaxed));
+        }
+    };
+
+    class lock_site: public site{
+    public:
+        histogram wait_ns;   // time from lock() to owning the mutex
+        histogram hold_ns;   // time from owning to unlock(), exclusive owners
+        histogram shared_hold_ns; // time from owning to unlock_shared(), shared owners
+        counter contended;   // acquisitions where the first try_lock failed
+
+        explicit lock_site(const char* n): site(n){ register_site(); }
+        [[nodiscard]] bool is_lock() const override{ return true; }
+        void write_json(std::ostream& os) const override{
+            const auto wait = wait_ns.merge();
+            os << "{\"name\":\"" << name << "\",\"acquisitions\":" << wait.total
+               << ",\"contended\":" << contended.load() << ",\"wait_ns\":";
+            wait.write_json(os);
+            os << ",\"hold_ns\":";
+            hold_ns.merge().write_json(os);
+            os << ",\"shared_hold_ns\":";
+            shared_hold_ns.merge().write_json(os);
+            os << "}";
+        }
+    };
+
+    class queue_site: public site{
+    public:
+        histogram depth;       // queue length right after each push
+        histogram latency_ns;  // time from push to the pop that removed the element
+
+        explicit queue_site(const char* n): site(n){ register_site(); }
+        [[nodiscard]] bool is_lock() const override{ return false; }
+        void write_json(std::ostream& os) const override{
+            os << "{\"name\":\"" << name << "\",\"depth\":";
+            depth.merge().write_json(os);
+            os << ",\"latency_ns\":";
+            latency_ns.merge().write_json(os);
+            os << "}";
+        }
+    };
+
+    // Lockable wrapper; also SharedLockable when M is, shared hold time goes to its own histogram
+    template<typename M, site_name Name>
+    class instrumented_mutex{
+    private:
+        M m;
+        clock::time_point acquired; // written only by the exclusive owner
+
+        // Shared owners are many threads at once, so each keeps its acquire time per site; a thread holding
+        // two instances of one site shared at the same time times the inner one only
+        static clock::time_point& shared_acquired(){
+            thread_local clock::time_point stamp;
+            return stamp;
+        }
+
+        static lock_site& stats(){
+            static lock_site s(Name.value);
+            return s;
+        }
+        template<typename TryLock, typename Lock>
+        static void acquire(TryLock try_lock, Lock lock){
+            if(try_lock()){
+                stats().wait_ns.record(0);
+                return;
+            }
+            stats().contended.increment();
+            const auto start = clock::now();
+            lock();
+            stats().wait_ns.record(elapsed_ns(start, clock::now()));
+        }
+    public:
+        instrumented_mutex() = default;
+        instrumented_mutex(const instrumented_mutex&) = delete;
+        instrumented_mutex& operator=(const instrumented_mutex&) = delete;
+
+        void lock(){
+            acquire([this]{return m.try_lock();}, [this]{m.lock();});
+            acquired = clock::now();
+        }
+        bool try_lock(){
+            if(!m.try_lock()){
+                return false;
+            }
+            stats().wait_ns.record(0);
+            acquired = clock::now();
+            return true;
+        }
+        void unlock(){
+            stats().hold_ns.record(elapsed_ns(acquired, clock::now()));
+            m.unlock();
+        }
+
+        void lock_shared() requires requires(M& x){ x.lock_shared(); }{
+            acquire([this]{return m.try_lock_shared();}, [this]{m.lock_shared();});
+            shared_acquired() = clock::now();
+        }
+        bool try_lock_shared() requires requires(M& x){ x.try_lock_shared(); }{
+            if(!m.try_lock_shared()){
+                return false;
+            }
+            stats().wait_ns.record(0);
+            shared_acquired() = clock::now();
+            return true;
+        }
+        void unlock_shared() requires requires(M& x){ x.unlock_shared(); }{
+            stats().shared_hold_ns.record(elapsed_ns(shared_acquired(), clock::now()));
+            m.unlock_shared();
+        }
+    };
+
+    // Caller holds the queue's own lock, so the timestamps need no synchronisation of their own
+    template<site_name Name>
+    class instrumented_queue_probe{
+    private:
+        std::queue<clock::time_point> stamps;
+
+        static queue_site& stats(){
+            static queue_site s(Name.value);
+            return s;
+        }
+    public:
+        void pushed(std::size_t depth){
+            stamps.push(clock::now());
+            stats().depth.record(depth);
+        }
+        void popped(){
+            stats().latency_ns.record(elapsed_ns(stamps.front(), clock::now()));
+            stamps.pop();
+        }
+    };
+
+    struct null_queue_probe{
+        void pushed(std::size_t){}
+        void popped(){}
+    };
+
+    template<typename M, site_name Name>
+    using mutex = std::conditional_t<enabled, instrumented_mutex<M, Name>, M>;
+
+    template<site_name Name>
+    using queue_probe = std::conditional_t<enabled, instrumented_queue_probe<Name>, null_queue_probe>;
+
+    // Writes {"locks":[...],"queues":[...]} for every site used so far; safe to call while the sites are in use
+    inline void dump_json(std::ostream& os){
+        const site* head = site::registry().load(std::memory_order_acquire);
+        for(bool locks: {true, false}){
+            os << (locks ? "{\"locks\":[" : "],\"queues\":[");
+            bool first = true;
+            for(const site* s = head; s; s = s->next){
+                if(s->is_lock() == locks){
+                    os << (first ? "" : ",");
+                    s->write_json(os);
+                    first = false;
+                }
+            }
+        }
+        os << "]}\n";
+    }
+
+} // Instrumentation
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <tuple>
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <string>
+
+/*
+ * Asynchronous buffered logging
+ *  Every thread writes records into its own single producer / single consumer ring, no locks on the hot path
+ *  Arguments are captured by value and only formatted by the background flusher thread
+ *  The flusher merges the rings by timestamp and flushes std::cout once per pass instead of once per line
+ *
+ * Compile time control
+ *  LOGGING_DISABLED        every call compiles to nothing
+ *  LOGGING_MIN_LEVEL n     calls below level n compile to nothing (0 trace ... 4 error)
+ */
+
+#ifndef LOGGING_MIN_LEVEL
+#define LOGGING_MIN_LEVEL 0
+#endif
+
+namespace Logging{
+
+    enum class level : int { trace = 0, debug, info, warn, error, off };
+
+#ifdef LOGGING_DISABLED
+    inline constexpr level compiled_level = level::off;
+#else
+    inline constexpr level compiled_level = static_cast<level>(LOGGING_MIN_LEVEL);
+#endif
+
+    inline const char* prefix(level l){
+        switch(l){
+            case level::warn: return "[warn] ";
+            case level::error: return "[error] ";
+            default: return "";
+        }
+    }
+
+    // How an argument is kept until the flusher formats it. Character pointers may point into short lived
+    // buffers such as c_str() or what(), so they are copied; const character arrays are string literals and
+    // outlive every record, so only the pointer is kept
+    template<typename T>
+    using captured_t = std::conditional_t<
+        std::is_same_v<std::decay_t<T>, char*> ||
+        (std::is_same_v<std::decay_t<T>, const char*> && !std::is_array_v<std::remove_reference_t<T>>),
+        std::string, std::decay_t<T>>;
+
+    // One captured log call, formatted lazily by the flusher
+    struct record{
+        static constexpr std::size_t payload_size = 96;
+
+        std::chrono::steady_clock::time_point stamp;
+        level lvl{level::info};
+        void (*write)(std::ostream&, const void*){nullptr};
+        void (*destroy)(void*){nullptr};
+        alignas(std::max_align_t) std::byte payload[payload_size];
+
+        template<typename... Args>
+        void capture(level l, Args&&... args){
+            using tuple_type = std::tuple<captured_t<Args>...>;
+            static_assert(sizeof(tuple_type) <= payload_size, "Log arguments too large for a record");
+            static_assert(alignof(tuple_type) <= alignof(std::max_align_t), "Log arguments over aligned");
+            stamp = std::chrono::steady_clock::now();
+            lvl = l;
+            ::new(static_cast<void*>(payload)) tuple_type(std::forward<Args>(args)...);
+            write = [](std::ostream& os, const void* p){
+                std::apply([&os](const auto&... a){ (os << ... << a); }, *static_cast<const tuple_type*>(p));
+            };
+            destroy = [](void* p){ static_cast<tuple_type*>(p)->~tuple_type(); };
+        }
+        void release(){
+            destroy(payload);
+        }
+    };
+
+    // Bounded ring owned by one producing thread, drained only by the flusher
+    class thread_buffer{
+    public:
+        static constexpr std::size_t capacity = 512; // power of two
+    private:
+        alignas(64) std::atomic<std::size_t> head{0}; // next slot to write, producer owned
+        alignas(64) std::atomic<std::size_t> tail{0}; // next slot to read, flusher owned
+        std::unique_ptr<record[]> slots{new record[capacity]};
+    public:
+        thread_buffer() = default;
+        thread_buffer(const thread_buffer&) = delete;
+        thread_buffer& operator=(const thread_buffer&) = delete;
+        ~thread_buffer(){
+            while(record* r = front()){
+                r->release();
+                pop_front();
+            }
+        }
+        // Producer side; returns nullptr when full
+        record* reserve(){
+            const std::size_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) == capacity){
+                return nullptr;
+            }
+            return &slots[h & (capacity - 1)];
+        }
+        void commit(){
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        // Flusher side; returns nullptr when empty
+        record* front(){
+            const std::size_t t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire)){
+                return nullptr;
+            }
+            return &slots[t & (capacity - 1)];
+        }
+        void pop_front(){
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    };
+
+    class logger{
+    private:
+        std::ostream& out;
+        const std::uint64_t id{next_id()}; // keys the per thread rings, unlike the address it is never reused
+        std::atomic<level> threshold{level::trace};
+        std::mutex registry_mutex; // only taken when a thread logs for the first time and by the flusher
+        std::vector<std::shared_ptr<thread_buffer>> buffers;
+        std::mutex wake_mutex;
+        std::condition_variable wake_cond;
+        bool wake_requested{false};
+        bool stopping{false};
+        std::chrono::milliseconds interval{5};
+        std::thread flusher;
+
+        static std::uint64_t next_id(){
+            static std::atomic<std::uint64_t> last{0};
+            return last.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        // Drain whatever is visible in every ring, oldest first
+        bool drain(){
+            std::vector<std::shared_ptr<thread_buffer>> snapshot;
+            {
+                std::lock_guard<std::mutex> lk(registry_mutex);
+                // Rings whose thread has exited and that have been drained can go
+                std::erase_if(buffers, [](const auto& b){return b.use_count() == 1 && !b->front();});
+                snapshot = buffers;
+            }
+            struct cursor{
+                record* r;
+                thread_buffer* b;
+                std::size_t budget; // bounds the pass so a busy producer cannot starve the others
+            };
+            std::vector<cursor> pending;
+            for(auto& b: snapshot){
+                if(record* r = b->front()){
+                    pending.push_back({r, b.get(), thread_buffer::capacity});
+                }
+            }
+            bool wrote = false;
+            // Rings are individually ordered, so repeatedly taking the oldest head is a k-way merge
+            while(!pending.empty()){
+                auto oldest = std::min_element(pending.begin(), pending.end(), [](const cursor& a, const cursor& b){
+                    return a.r->stamp < b.r->stamp;
+                });
+                out << prefix(oldest->r->lvl);
+                oldest->r->write(out, oldest->r->payload);
+                out << '\n';
+                oldest->r->release();
+                oldest->b->pop_front();
+                wrote = true;
+                record* next = --oldest->budget ? oldest->b->front() : nullptr;
+                if(next){
+                    oldest->r = next;
+                } else {
+                    pending.erase(oldest);
+                }
+            }
+            if(wrote){
+                out.flush();
+            }
+            return wrote;
+        }
+
+        void run(){
+            std::unique_lock<std::mutex> lk(wake_mutex);
+            while(!stopping){
+                wake_cond.wait_for(lk, interval, [this]{return stopping || wake_requested;});
+                wake_requested = false;
+                lk.unlock();
+                drain();
+                lk.lock();
+            }
+            lk.unlock();
+            while(drain()){}
+        }
+
+    public:
+        explicit logger(std::ostream& os = std::cout): out(os), flusher(&logger::run, this){}
+        logger(const logger&) = delete;
+        logger& operator=(const logger&) = delete;
+        ~logger(){
+            {
+                std::lock_guard<std::mutex> lk(wake_mutex);
+                stopping = true;
+            }
+            wake_cond.notify_one();
+            flusher.join();
+        }
+
+        static logger& instance(){
+            static logger log;
+            return log;
+        }
+
+        void set_level(level l){
+            threshold.store(l, std::memory_order_relaxed);
+        }
+        [[nodiscard]] bool enabled(level l) const{
+            return l >= threshold.load(std::memory_order_relaxed);
+        }
+
+        std::shared_ptr<thread_buffer> register_thread(){
+            auto b = std::make_shared<thread_buffer>();
+            std::lock_guard<std::mutex> lk(registry_mutex);
+            buffers.push_back(b);
+            return b;
+        }
+
+        // Ask the flusher for an early pass, used when a ring fills up
+        void request_flush(){
+            {
+                std::lock_guard<std::mutex> lk(wake_mutex);
+                wake_requested = true;
+            }
+            wake_cond.notify_one();
+        }
+
+        // The calling thread's ring for this logger, one per thread and logger whatever the argument types.
+        // A ring whose logger has been destroyed is only referenced from here and is dropped on the next miss
+        thread_buffer& local_buffer(){
+            struct entry{
+                std::uint64_t owner;
+                std::shared_ptr<thread_buffer> ring;
+            };
+            thread_local std::vector<entry> rings;
+            for(const entry& e: rings){
+                if(e.owner == id){
+                    return *e.ring;
+                }
+            }
+            std::erase_if(rings, [](const entry& e){return e.ring.use_count() == 1;});
+            rings.push_back({id, register_thread()});
+            return *rings.back().ring;
+        }
+
+        template<typename... Args>
+        void write(level l, Args&&... args){
+            thread_buffer& local = local_buffer();
+            record* r = local.reserve();
+            while(!r){
+                // Full ring: never drop, nudge the flusher and back off
+                request_flush();
+                std::this_thread::yield();
+                r = local.reserve();
+            }
+            r->capture(l, std::forward<Args>(args)...);
+            local.commit();
+        }
+    };
+
+    template<level L, typename... Args>
+    void log(Args&&... args){
+        if constexpr(L >= compiled_level && L != level::off){
+            logger& lg = logger::instance();
+            if(lg.enabled(L)){
+                lg.write(L, std::forward<Args>(args)...);
+            }
+        }
+    }
+
+    template<typename... Args> void trace(Args&&... args){ log<level::trace>(std::forward<Args>(args)...); }
+    template<typename... Args> void debug(Args&&... args){ log<level::debug>(std::forward<Args>(args)...); }
+    template<typename... Args> void info(Args&&... args){ log<level::info>(std::forward<Args>(args)...); }
+    template<typename... Args> void warn(Args&&... args){ log<level::warn>(std::forward<Args>(args)...); }
+    template<typename... Args> void error(Args&&... args){ log<level::error>(std::forward<Args>(args)...); }
+
+    inline void set_level(level l){
+        if constexpr(compiled_level != level::off){
+            logger::instance().set_level(l);
+        }
+    }
+
+} // Logging
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <new>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * CPU and NUMA placement for worker threads (Linux; elsewhere every policy behaves like none)
+ *  topology          cpus the process may run on, with core, package and node read from /sys, and the pool
+ *                    size per policy counted node by node
+ *  policy            none leaves threads to the scheduler, pin uses cpu order, compact fills one node and
+ *                    its hyperthread siblings first, spread round robins workers over the nodes
+ *  make_thread       std::thread that applies a policy to itself before running the callable, usable with
+ *                    joining_thread and scoped_thread
+ *  node_buffer       untouched page aligned memory, first_touch writes each worker's block from that worker
+ *                    so its pages are allocated on the worker's node
+ */
+
+namespace Placement{
+
+    enum class policy { none, pin, compact, spread };
+
+    inline policy policy_from_string(const std::string& s){
+        if(s == "none") return policy::none;
+        if(s == "pin") return policy::pin;
+        if(s == "compact") return policy::compact;
+        if(s == "spread") return policy::spread;
+        throw std::invalid_argument("Unknown placement policy: " + s);
+    }
+
+    struct cpu{
+        unsigned id{0};
+        unsigned core{0};
+        unsigned package{0};
+        unsigned node{0};
+    };
+
+    // Parses the /sys list format, e.g. "0-3,8,10-11"
+    inline std::vector<unsigned> parse_cpu_list(const std::string& text){
+        std::vector<unsigned> out;
+        std::stringstream ss(text);
+        std::string range;
+        while(std::getline(ss, range, ',')){
+            if(range.empty() || range == "\n"){
+                continue;
+            }
+            const auto dash = range.find('-');
+            const unsigned lo = static_cast<unsigned>(std::stoul(range.substr(0, dash)));
+            const unsigned hi = dash == std::string::npos ? lo : static_cast<unsigned>(std::stoul(range.substr(dash + 1)));
+            for(unsigned c = lo; c <= hi; ++c){
+                out.push_back(c);
+            }
+        }
+        return out;
+    }
+
+    class topology{
+    private:
+        std::vector<cpu> cpus;      // allowed cpus ordered by id
+        std::vector<unsigned> node_ids;
+        std::vector<unsigned> compact_order; // by node, package, core so hyperthread siblings are adjacent
+
+        static bool read_file(const std::string& path, std::string& out){
+            std::ifstream in(path);
+            return static_cast<bool>(std::getline(in, out));
+        }
+        static unsigned read_unsigned(const std::string& path, unsigned fallback){
+            std::string s;
+            return read_file(path, s) && !s.empty() ? static_cast<unsigned>(std::stoul(s)) : fallback;
+        }
+
+    public:
+        // Built from the calling thread's affinity mask, so query it before pinning anything
+        topology(){
+            std::string online;
+            std::vector<unsigned> ids = read_file("/sys/devices/system/cpu/online", online) ? parse_cpu_list(online) : std::vector<unsigned>{};
+            if(ids.empty()){
+                for(unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c){
+                    ids.push_back(c);
+                }
+            }
+#ifdef __linux__
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0){
+                std::erase_if(ids, [&](unsigned c){return c >= CPU_SETSIZE || !CPU_ISSET(c, &allowed);});
+            }
+#endif
+            // cpu -> node from /sys/devices/system/node/node<N>/cpulist, absent on kernels without NUMA
+            std::map<unsigned, unsigned> node_of;
+            std::error_code ec;
+            for(const auto& entry: std::filesystem::directory_iterator("/sys/devices/system/node", ec)){
+                const std::string name = entry.path().filename().string();
+                std::string list;
+                if(name.rfind("node", 0) != 0 || name.size() == 4 || !std::isdigit(static_cast<unsigned char>(name[4])) ||
+                   !read_file(entry.path().string() + "/cpulist", list)){
+                    continue;
+                }
+                const auto n = static_cast<unsigned>(std::stoul(name.substr(4)));
+                for(unsigned c: parse_cpu_list(list)){
+                    node_of[c] = n;
+                }
+            }
+            std::set<unsigned> nodes;
+            for(unsigned id: ids){
+                const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+                cpu c;
+                c.id = id;
+                c.core = read_unsigned(base + "/topology/core_id", id);
+                c.package = read_unsigned(base + "/topology/physical_package_id", 0);
+                const auto it = node_of.find(id);
+                c.node = it != node_of.end() ? it->second : 0;
+                nodes.insert(c.node);
+                cpus.push_back(c);
+            }
+            node_ids.assign(nodes.begin(), nodes.end());
+            std::vector<cpu> order = cpus;
+            std::stable_sort(order.begin(), order.end(), [](const cpu& a, const cpu& b){
+                return std::tie(a.node, a.package, a.core) < std::tie(b.node, b.package, b.core);
+            });
+            for(const cpu& c: order){
+                compact_order.push_back(c.id);
+            }
+        }
+
+        static const topology& system(){
+            static const topology t;
+            return t;
+        }
+
+        [[nodiscard]] const std::vector<cpu>& all() const{ return cpus; }
+        [[nodiscard]] unsigned cpu_count() const{ return static_cast<unsigned>(cpus.size()); }
+        [[nodiscard]] const std::vector<unsigned>& nodes() const{ return node_ids; }
+
+        [[nodiscard]] std::vector<cpu> cpus_on_node(unsigned node) const{
+            std::vector<cpu> out;
+            std::copy_if(cpus.begin(), cpus.end(), std::back_inserter(out), [node](const cpu& c){return c.node == node;});
+            return out;
+        }
+
+        // Worker count built up node by node. Spread gives every node the cpu count of the smallest node, so
+        // its round robin never doubles up on one node while another has idle cpus; the other policies use
+        // every cpu of every node. A limit is rounded down to whole rounds over the nodes under spread.
+        [[nodiscard]] unsigned long pool_size(policy p, unsigned long limit = 0) const{
+            if(p != policy::spread){
+                unsigned long total = 0;
+                for(unsigned node: node_ids){
+                    total += cpus_on_node(node).size();
+                }
+                return limit ? std::min(limit, total) : total;
+            }
+            std::size_t per_node = cpus.size();
+            for(unsigned node: node_ids){
+                per_node = std::min(per_node, cpus_on_node(node).size());
+            }
+            const unsigned long nodes = node_ids.size();
+            const unsigned long total = nodes * per_node;
+            if(!limit || limit >= total){
+                return total;
+            }
+            return limit < nodes ? limit : limit - limit % nodes;
+        }
+
+        // Cpu for the index'th worker under a policy, wrapping when there are more workers than cpus
+        [[nodiscard]] unsigned cpu_for(policy p, unsigned index) const{
+            switch(p){
+                case policy::compact:
+                    return compact_order[index % compact_order.size()];
+                case policy::spread:{
+                    const unsigned node = node_ids[index % node_ids.size()];
+                    const auto local = cpus_on_node(node);
+                    return local[(index / node_ids.size()) % local.size()].id;
+                }
+                default:
+                    return cpus[index % cpus.size()].id;
+            }
+        }
+    };
+
+    // Pins the calling thread; false when the platform or the kernel refuses
+    inline bool pin_current_thread(unsigned cpu_id){
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu_id, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu_id;
+        return false;
+#endif
+    }
+
+    inline bool apply(policy p, unsigned index){
+        if(p == policy::none){
+            return false;
+        }
+        return pin_current_thread(topology::system().cpu_for(p, index));
+    }
+
+    template<typename Callable, typename... Args>
+    std::thread make_thread(policy p, unsigned index, Callable&& func, Args&&... args){
+        if(p != policy::none){
+            topology::system(); // read the unpinned mask before any worker pins itself
+        }
+        return std::thread([p, index](auto&& f, auto&&... a){
+            apply(p, index);
+            std::invoke(std::forward<decltype(f)>(f), std::forward<decltype(a)>(a)...);
+        }, std::forward<Callable>(func), std::forward<Args>(args)...);
+    }
+
+    // Page aligned storage left untouched so the first writer decides which node each page lives on
+    template<typename T>
+    class node_buffer{
+        static_assert(std::is_trivially_copyable_v<T>, "node_buffer holds trivially copyable values only");
+        T* ptr{nullptr};
+        std::size_t count{0};
+    public:
+        explicit node_buffer(std::size_t n): count(n){
+            if(!n){
+                return;
+            }
+#ifdef __linux__
+            void* p = ::mmap(nullptr, n * sizeof(T), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(p == MAP_FAILED){
+                throw std::bad_alloc();
+            }
+            ptr = static_cast<T*>(p);
+#else
+            ptr = static_cast<T*>(::operator new(n * sizeof(T)));
+#endif
+        }
+        node_buffer(const node_buffer&) = delete;
+        node_buffer& operator=(const node_buffer&) = delete;
+        ~node_buffer(){
+            if(!ptr){
+                return;
+            }
+#ifdef __linux__
+            ::munmap(ptr, count * sizeof(T));
+#else
+            ::operator delete(ptr);
+#endif
+        }
+        T* begin(){ return ptr; }
+        T* end(){ return ptr + count; }
+        T* data(){ return ptr; }
+        [[nodiscard]] std::size_t size() const{ return count; }
+    };
+
+    // Writes value(i) into every element, block b written by worker b placed by p, using the same
+    // blocks as threads_at_runtime::parallel_accumulate with num_threads workers
+    template<typename T, typename Value>
+    void first_touch(node_buffer<T>& buffer, unsigned long num_threads, policy p, Value value){
+        num_threads = std::max(1ul, num_threads);
+        const std::size_t block_size = buffer.size() / num_threads;
+        std::vector<std::thread> threads;
+        for(unsigned long b = 0; b < num_threads; ++b){
+            const std::size_t first = b * block_size;
+            const std::size_t last = b + 1 == num_threads ? buffer.size() : first + block_size;
+            threads.push_back(make_thread(p, static_cast<unsigned>(b), [&buffer, &value, first, last]{
+                for(std::size_t i = first; i < last; ++i){
+                    buffer.data()[i] = value(i);
+                }
+            }));
+        }
+        for(auto& t: threads){
+            t.join();
+        }
+    }
+
+} // Placement